@@ -0,0 +1,84 @@
+#define USE_US_TIMER	// Necessary for enabling ETSTimer's microsecond accuracy
+
+#include "AnalogInput.h"
+
+#ifdef ARDUINO
+extern "C" {
+#include "user_interface.h"
+}
+#endif
+
+AnalogInput::AnalogInput(uint8_t decimation, uint8_t filter) :
+n_overruns(0), filter(filter), count(0), sum(0), last(0),
+block_handler(NULL), block_userdata(NULL) {
+	set_decimation(decimation);
+}
+
+#ifdef ARDUINO
+
+bool AnalogInput::begin(uint32_t sample_rate) {
+	system_timer_reinit();
+	ets_timer_setfn(&timer, timer_callback, this);
+	ets_timer_arm_new(&timer, 1000000 / sample_rate, true, 0);
+	return true;
+}
+
+void AnalogInput::end() {
+	ets_timer_disarm(&timer);
+}
+
+void AnalogInput::timer_callback(void *arg) {
+	((AnalogInput *)arg)->push(system_adc_read());
+}
+
+#endif
+
+void AnalogInput::set_decimation(uint8_t n) {
+	n = n > 0 ? n : 1;
+	decimation = n < AIN_MAX_DECIMATION ? n : AIN_MAX_DECIMATION;
+	count = 0;
+	sum = 0;
+}
+
+uint16_t AnalogInput::loop() {
+	uint16_t block[AIN_BLOCK_LEN];
+	uint16_t n = 0;
+	uint16_t x;
+	uint16_t n_total = 0;
+
+	while (buffer.pop(x)) {
+		sum += x;
+		group[count++] = x;
+		if (count < decimation)
+			continue;
+
+		// End of group
+		last = filter == AIN_MEDIAN ? median() : sum / decimation;
+		count = 0;
+		sum = 0;
+		block[n++] = last;
+		if (n == AIN_BLOCK_LEN) {
+			if (block_handler)
+				block_handler(block, n, block_userdata);
+			n_total += n;
+			n = 0;
+		}
+	}
+	if (n > 0 && block_handler)
+		block_handler(block, n, block_userdata);
+	return n_total + n;
+}
+
+uint16_t AnalogInput::median() {
+	uint16_t x;
+	int i, j;
+
+	// Insertion sort in place; the group is refilled after this
+	for (i = 1; i < decimation; i++) {
+		x = group[i];
+		for (j = i; j > 0 && group[j - 1] > x; j--)
+			group[j] = group[j - 1];
+		group[j] = x;
+	}
+	return group[decimation / 2];
+}
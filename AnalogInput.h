@@ -0,0 +1,100 @@
+/*
+ *	AnalogInput.h
+ */
+#ifndef ANALOGINPUT_H
+#define ANALOGINPUT_H
+
+#ifdef ARDUINO
+#include "Arduino.h"
+extern "C" {
+#include "ets_sys.h"
+}
+#else
+#include <stddef.h>
+#endif
+
+#include "RingBuffer.h"
+
+// Allow user redefinition of the raw sample buffer and filtered block lengths
+#ifndef AIN_BUFFER_LEN
+#define AIN_BUFFER_LEN 256
+#endif
+#ifndef AIN_BLOCK_LEN
+#define AIN_BLOCK_LEN 16
+#endif
+
+#define AIN_MAX_DECIMATION 16
+
+// Decimating filters
+enum {
+	AIN_BOXCAR = 0,		// Mean of each group of samples
+	AIN_MEDIAN			// Median of each group (rejects spikes)
+};
+
+// Samples the ADC from a timer into a ring buffer, and in loop() reduces each
+// group of n raw samples to one filtered sample (mean or median, in integer
+// arithmetic) on the same 0-1023 scale. Filtered samples are passed to a block
+// handler, e.g. a Gate's process(), so the ADC costs a fixed amount of timer
+// time per sample and nothing in the main loop blocks on a read.
+class AnalogInput {
+
+public:
+
+	AnalogInput(uint8_t decimation = 4, uint8_t filter = AIN_BOXCAR);
+
+#ifdef ARDUINO
+	// Start/stop sampling the ADC at the given (raw) sample rate
+	bool begin(uint32_t sample_rate);
+	void end();
+#endif
+
+	// Raw samples per filtered sample [1-AIN_MAX_DECIMATION], and filter type
+	void set_decimation(uint8_t n);
+	void set_filter(uint8_t type)		{ filter = type; }
+
+	// Set the function that receives blocks of n filtered samples
+	void set_block_handler(void (*handler)(const uint16_t *, uint16_t, void *), void *userdata) {
+		block_handler = handler;
+		block_userdata = userdata;
+	}
+
+	// Queue a raw sample; called by the timer, or by the user for other sources
+	void push(uint16_t x) {
+		if (!buffer.push(x))
+			n_overruns++;
+	}
+
+	// Filter the queued samples and pass them to the block handler; call often
+	// from loop(). Returns the number of filtered samples produced.
+	uint16_t loop();
+
+	// Latest filtered sample
+	uint16_t value()					{ return last; }
+
+	// Raw samples dropped because the buffer was full
+	uint32_t overruns()					{ return n_overruns; }
+
+protected:
+
+#ifdef ARDUINO
+	static void timer_callback(void *arg);
+	ETSTimer timer;
+#endif
+
+	uint16_t median();
+
+	RingBuffer<uint16_t, AIN_BUFFER_LEN> buffer;
+	volatile uint32_t n_overruns;
+
+	uint8_t decimation;
+	uint8_t filter;
+	uint8_t count;							// Raw samples in the current group
+	uint32_t sum;							// - their sum (boxcar)
+	uint16_t group[AIN_MAX_DECIMATION];		// - the samples (median)
+	uint16_t last;
+
+	void (*block_handler)(const uint16_t *, uint16_t, void *);	// User block callback
+	void *block_userdata;										// - its userdata
+};
+
+#endif
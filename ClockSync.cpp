@@ -0,0 +1,79 @@
+#include "ClockSync.h"
+
+ClockSync::ClockSync() :
+is_master(false), local(0), time(0), frac(0), freq(0), slew(0), slew_left(0),
+pending(false), step(0), new_freq(0), new_slew(0), new_slew_left(0), was_stepped(false),
+n_exchanges(0), last_exchange(0), min_rtt(0), last_rtt(0), last_error(0) {
+
+}
+
+bool ClockSync::exchange(uint32_t t1, uint32_t t2, uint32_t t3) {
+	uint32_t t4 = local;
+	uint32_t t = time;
+
+	// Masters don't follow; wait for tick() to take the last correction
+	if (is_master || __atomic_load_n(&pending, __ATOMIC_ACQUIRE))
+		return false;
+
+	// Round trip, less the master's turnaround
+	int32_t rtt = (int32_t)((t4 - t1) - (t3 - t2));
+	last_rtt = rtt > 0 ? rtt : 0;
+
+	// Discard exchanges delayed on the way; the minimum creeps up in case the
+	// route got longer
+	if (n_exchanges == 0 || last_rtt < min_rtt)
+		min_rtt = last_rtt;
+	else
+		min_rtt++;
+	if (last_rtt > min_rtt + (min_rtt >> 2) + CS_RTT_SLACK)
+		return false;
+
+	// The master's clock now is its reply time plus half the round trip
+	int32_t err = (int32_t)(t3 + last_rtt / 2 - t);
+	last_error = err;
+
+	if (n_exchanges == 0 || err > CS_STEP_THRESHOLD || err < -CS_STEP_THRESHOLD) {
+		step = err;
+		new_slew = 0;
+		new_slew_left = 0;
+	}
+	else {
+		// Slew part of the error out over the next interval (P), and add a
+		// smaller part of the same rate to the frequency correction (I)
+		uint32_t interval = t4 - last_exchange;
+		interval = interval > 0 ? interval : 1;
+		int64_t rate = ((int64_t)err << 32) / interval;
+		int64_t f = new_freq + (rate >> CS_FREQ_SHIFT);
+		rate >>= CS_PHASE_SHIFT;
+		f = f < CS_FREQ_MAX ? f : CS_FREQ_MAX;
+		f = f > -CS_FREQ_MAX ? f : -CS_FREQ_MAX;
+		rate = rate < INT32_MAX ? rate : INT32_MAX;
+		rate = rate > -INT32_MAX ? rate : -INT32_MAX;
+		new_freq = f;
+		new_slew = rate;
+		new_slew_left = interval;
+	}
+
+	last_exchange = t4;
+	n_exchanges++;
+	__atomic_store_n(&pending, true, __ATOMIC_RELEASE);
+	return true;
+}
+
+bool ClockSync::stepped() {
+	bool s = was_stepped;
+	was_stepped = false;
+	return s;
+}
+
+void ClockSync::reset() {
+	// Withdraw any correction tick() hasn't taken while this one is written
+	__atomic_store_n(&pending, false, __ATOMIC_RELEASE);
+	n_exchanges = 0;
+	last_error = 0;
+	step = 0;
+	new_freq = 0;
+	new_slew = 0;
+	new_slew_left = 0;
+	__atomic_store_n(&pending, true, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,122 @@
+/*
+ *	ClockSync.h
+ */
+#ifndef CLOCKSYNC_H
+#define CLOCKSYNC_H
+
+#include <stdint.h>
+
+// Defaults
+#define CS_PHASE_SHIFT 2			// Phase correction: 1/4 of each error per interval
+#define CS_FREQ_SHIFT 6				// Frequency correction: 1/64 of each error rate
+#define CS_FREQ_MAX 2147484			// Largest frequency correction (500ppm, Q32)
+#define CS_STEP_THRESHOLD 64		// Phase errors above this (samples) are stepped
+#define CS_LOCK_THRESHOLD 16		// Locked while the phase error is within this (samples)
+#define CS_RTT_SLACK 8				// Round trips up to min + 1/4 + slack are used (samples)
+
+// Keeps a sample clock in step with a master's. Each exchange (NTP-style: the
+// node's send time t1, the master's receive and reply times t2 and t3, and the
+// node's receive time t4) gives the master's clock offset; exchanges with a
+// round trip well above the shortest seen are discarded. Part of the phase
+// error is slewed out over the following exchange interval and part is
+// integrated into a frequency correction (PI loop); corrections are applied by
+// rendering 0 or 2 samples instead of 1 on some ticks. Errors over
+// CS_STEP_THRESHOLD step the clock instead; stepped() reports it so the sketch
+// can realign generators to now().
+//
+// exchange() runs in the main loop and tick() in the render callback; new
+// corrections are handed over at a tick boundary.
+class ClockSync {
+
+public:
+
+	ClockSync();
+
+	// Master clocks run free and answer requests (see OSCManager)
+	void set_master(bool master)	{ is_master = master; }
+	bool master()					{ return is_master; }
+
+	// Call once per render tick; returns the number of samples to render
+	// (0, 1 or 2) to stay in step with the master
+	uint8_t tick() {
+		uint8_t n = 1;
+		local++;
+		if (__atomic_load_n(&pending, __ATOMIC_ACQUIRE)) {
+			if (step)
+				was_stepped = true;
+			time += step;
+			freq = new_freq;
+			slew = new_slew;
+			slew_left = new_slew_left;
+			step = 0;
+			__atomic_store_n(&pending, false, __ATOMIC_RELEASE);
+		}
+		frac += freq;
+		if (slew_left) {
+			frac += slew;
+			slew_left--;
+		}
+		if (frac >= ((int64_t)1 << 32)) {
+			frac -= (int64_t)1 << 32;
+			n = 2;
+		}
+		else if (frac <= -((int64_t)1 << 32)) {
+			frac += (int64_t)1 << 32;
+			n = 0;
+		}
+		time += n;
+		return n;
+	}
+
+	// Synchronized time (samples of the master's clock) and the local tick count
+	uint32_t now()					{ return time; }
+	uint32_t local_time()			{ return local; }
+
+	// Process an exchange; t1 is the local time the request was sent, t2 and
+	// t3 the master's times it was received and answered. Call when the reply
+	// arrives. Returns false if the exchange was discarded.
+	bool exchange(uint32_t t1, uint32_t t2, uint32_t t3);
+
+	// Whether the clock was stepped since the last call
+	bool stepped();
+
+	// Forget the master and the corrections, and start over
+	void reset();
+
+	// Status
+	bool locked()					{ return n_exchanges >= 2 && last_error <= CS_LOCK_THRESHOLD && last_error >= -CS_LOCK_THRESHOLD; }
+	int32_t phase_error()			{ return last_error; }		// Samples at the last exchange
+	uint32_t round_trip()			{ return last_rtt; }		// Samples
+	int32_t drift_ppm()				{ return (int32_t)(-((int64_t)freq * 1000000) >> 32); }	// Local clock vs. master
+
+protected:
+
+	bool is_master;
+
+	// Render callback state
+	volatile uint32_t local;		// Ticks
+	volatile uint32_t time;			// Synchronized time
+	int64_t frac;					// Fractional sample accumulator (Q32)
+	int32_t freq;					// Frequency correction per tick (Q32)
+	int32_t slew;					// Phase correction per tick (Q32)
+	uint32_t slew_left;				// Ticks left to apply slew
+
+	// Corrections handed to tick(): the writer fills them, then publishes
+	// pending with a release store; the reader takes them after an acquire
+	// load and hands them back with a release store
+	bool pending;
+	int32_t step;
+	int32_t new_freq;
+	int32_t new_slew;
+	uint32_t new_slew_left;
+	volatile bool was_stepped;
+
+	// Estimator
+	uint32_t n_exchanges;
+	uint32_t last_exchange;			// Local time of the last used exchange
+	uint32_t min_rtt;
+	uint32_t last_rtt;
+	int32_t last_error;
+};
+
+#endif
@@ -0,0 +1,104 @@
+#include "ClockTracker.h"
+
+ClockTracker::ClockTracker() :
+now(0), last_edge(0), period(0), n_edges(0), edge_pending(false),
+mult(1), div(1), in_count(0), acc(0), inc(0), fire(false),
+smooth_shift(CT_DFLT_SMOOTH_SHIFT), pll_shift(CT_DFLT_PLL_SHIFT) {
+
+}
+
+void ClockTracker::set_ratio(uint16_t p_mult, uint16_t p_div) {
+	mult = p_mult > 0 ? p_mult : 1;
+	div = p_div > 0 ? p_div : 1;
+	in_count = 0;
+	update_increment();
+}
+
+void ClockTracker::reset() {
+	n_edges = 0;
+	in_count = 0;
+	acc = 0;
+	inc = 0;
+	fire = false;
+}
+
+bool ClockTracker::tick() {
+	bool out = false;
+	uint32_t prev;
+	if (edge_pending) {
+		edge_pending = false;
+		input_edge();
+	}
+	if (fire) {
+		fire = false;
+		out = true;
+	}
+	if (inc) {
+		prev = acc;
+		acc += inc;
+		if (acc < prev)
+			out = true;
+	}
+	now++;
+	return out;
+}
+
+void ClockTracker::input_edge() {
+
+	uint32_t interval = now - last_edge;
+	int32_t err;
+
+	// Ignore contact bounce and glitches
+	if (n_edges && interval < CT_MIN_PERIOD)
+		return;
+	last_edge = now;
+
+	// The first interval sets the period and starts the output
+	if (n_edges < 2) {
+		if (++n_edges == 2) {
+			period = interval << 8;
+			sync();
+		}
+		return;
+	}
+
+	// Resynchronize on tempo changes; otherwise smooth the period estimate
+	uint32_t measured = interval << 8;
+	uint32_t dev = measured > period ? measured - period : period - measured;
+	if (dev > period / CT_JUMP_FRACTION) {
+		period = measured;
+		sync();
+		return;
+	}
+	period = (int32_t)period + ((int32_t)(measured - period) >> smooth_shift);
+	update_increment();
+
+	// Correct the output phase on input edges that should coincide with an
+	// output edge (every div-th edge); the accumulator should be at zero, so its
+	// signed value is the phase error (positive if the output is early)
+	if (++in_count < div)
+		return;
+	in_count = 0;
+	err = (int32_t)acc;
+	err >>= pll_shift;
+	acc -= err;
+	// A late output corrected onto its edge skips the accumulator carry
+	if (err < 0 && acc < (uint32_t)(acc + err))
+		fire = true;
+}
+
+// Restart the output in phase with the current input edge
+void ClockTracker::sync() {
+	acc = 0;
+	in_count = 0;
+	fire = true;
+	update_increment();
+}
+
+void ClockTracker::update_increment() {
+	uint64_t inc64;
+	if (period == 0)
+		return;
+	inc64 = ((uint64_t)mult << 40) / ((uint64_t)period * div);
+	inc = inc64 < 0xFFFFFFFF ? inc64 : 0xFFFFFFFF;
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+/*
+ *	ClockTracker.h
+ */
+#ifndef CLOCKTRACKER_H
+#define CLOCKTRACKER_H
+
+#include <stdint.h>
+
+// Defaults
+#define CT_DFLT_SMOOTH_SHIFT 2		// Period smoothing: 1/4 of each new interval
+#define CT_DFLT_PLL_SHIFT 2			// Phase correction: 1/4 of the error per edge
+#define CT_JUMP_FRACTION 4			// Intervals off by more than 1/4 are tempo changes
+#define CT_MIN_PERIOD 16			// Shortest accepted clock period (samples)
+
+// Follows an external clock from edges reported in sample time and generates a
+// multiplied or divided clock that runs on between edges. The input period is
+// smoothed, and an output oscillator is phase-corrected at each aligned input
+// edge (PLL), so output edges land within a sample of the input once locked.
+// Intervals that differ from the estimate by more than CT_JUMP_FRACTION are
+// taken as tempo changes and resynchronize immediately.
+class ClockTracker {
+
+public:
+
+	ClockTracker();
+
+	// Output clock = input clock * mult / div
+	void set_ratio(uint16_t mult, uint16_t div);
+
+	// Smoothing of the period estimate and phase correction gain, as right
+	// shifts (0 follows every edge exactly)
+	void set_smoothing(uint8_t shift)	{ smooth_shift = shift; }
+	void set_pll_gain(uint8_t shift)	{ pll_shift = shift; }
+
+	// Report an input edge at the current sample; call before tick()
+	void edge()							{ edge_pending = true; }
+
+	// Advance one sample; returns true on an output clock edge
+	bool tick();
+
+	// Stop generating output until the next two edges
+	void reset();
+
+	// Estimated input period in samples (Q8) and whether the output is running
+	uint32_t period_q8()				{ return period; }
+	bool locked()						{ return n_edges >= 2; }
+
+	// Samples since the last input edge
+	uint32_t since_edge()				{ return now - last_edge; }
+
+protected:
+
+	void input_edge();
+	void sync();
+	void update_increment();
+
+	uint32_t now;				// Sample counter
+	uint32_t last_edge;			// Sample of the last input edge
+	uint32_t period;			// Smoothed input period (samples, Q8)
+	uint8_t n_edges;			// Input edges seen, saturating at 2
+	bool edge_pending;			// Edge reported for the current sample
+
+	uint16_t mult;				// Output edges per div input edges
+	uint16_t div;
+	uint16_t in_count;			// Input edges since the last aligned edge
+
+	uint32_t acc;				// Output phase (Q32 of an output period)
+	uint32_t inc;				// Output phase increment per sample
+	bool fire;					// Output edge due outside the phase accumulator
+
+	uint8_t smooth_shift;
+	uint8_t pll_shift;
+};
+
+#endif
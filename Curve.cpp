@@ -0,0 +1,18 @@
+#include "Curve.h"
+#include <math.h>
+
+static uint16_t tables[CURVE_MAX][CURVE_TABLE_LEN + 1];
+static bool computed[CURVE_MAX];
+
+const uint16_t *curve_table(uint8_t k) {
+	k = k > 1 ? k : 1;
+	k = k < CURVE_MAX ? k : CURVE_MAX;
+	uint16_t *t = tables[k - 1];
+	if (!computed[k - 1]) {
+		float norm = CURVE_ONE / (1.0f - expf(-(float)k));
+		for (int i = 0; i <= CURVE_TABLE_LEN; i++) 
+			t[i] = (1.0f - expf(-(float)k * i / CURVE_TABLE_LEN)) * norm + 0.5f;
+		computed[k - 1] = true;
+	}
+	return t;
+}
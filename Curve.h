@@ -0,0 +1,43 @@
+/*
+ *	Curve.h
+ */
+#ifndef CURVE_H
+#define CURVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CURVE_TABLE_BITS 6
+#define CURVE_TABLE_LEN (1 << CURVE_TABLE_BITS)
+#define CURVE_MAX 8
+#define CURVE_ONE 32768			// Table value at the end of a segment (Q15)
+
+// Segment shapes for the generator ramps, by curvature c in [-CURVE_MAX,
+// CURVE_MAX]: 0 is linear; c > 0 moves fast at first and slows into the target
+// ((1 - e^-cx) / (1 - e^-c), like an RC charge or discharge); c < 0 is the
+// mirror image, slow at first. A table of CURVE_TABLE_LEN + 1 points (Q15) per
+// curvature is computed on first use and shared by all generators; points in
+// between are interpolated linearly.
+
+// Table for curvature k [1-CURVE_MAX]; computes it the first time (float math,
+// so call from loop() or setup(), not the render callback)
+const uint16_t *curve_table(uint8_t k);
+
+// Clamp a curvature to [-CURVE_MAX, CURVE_MAX] and compute its table, so
+// segments can use it from the render callback
+inline int8_t curve_prepare(int8_t c) {
+	c = c < CURVE_MAX ? c : CURVE_MAX;
+	c = c > -CURVE_MAX ? c : -CURVE_MAX;
+	if (c)
+		curve_table(c > 0 ? c : -c);
+	return c;
+}
+
+// Fraction of the segment covered at progress p (Q32), Q15
+inline int32_t curve_lookup(const uint16_t *table, uint32_t p) {
+	uint32_t i = p >> (32 - CURVE_TABLE_BITS);
+	int32_t f = (p >> (16 - CURVE_TABLE_BITS)) & 0xFFFF;
+	return table[i] + (((int32_t)(table[i + 1] - table[i]) * f) >> 16);
+}
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ *	Dither.h
+ */
+#ifndef DITHER_H
+#define DITHER_H
+
+#include <stdint.h>
+
+// Reduces 16-bit samples (e.g. a generator's render_fine() output, 8.8 for 8-bit
+// builds) to the 8 bits sigmaDeltaWrite() takes, adding each sample's rounding
+// error to the next. The error is pushed to high frequencies that the output's
+// RC filter removes, so the filtered CV keeps the fractional resolution.
+// Optional noise (one output step, from a 16-bit LFSR) breaks up the idle tones
+// first-order shaping produces for slowly changing input.
+class Dither8 {
+
+public:
+
+	Dither8() : err(0), lfsr(0xACE1), noise(false) {}
+
+	void set_noise(bool enable)		{ noise = enable; }
+
+	// Constant-time, safe to call from the render callback
+	uint8_t process(uint16_t x) {
+		int32_t y = (int32_t)x + err;
+		int32_t q = y;
+		if (noise) {
+			lfsr = (lfsr >> 1) ^ (-(lfsr & 1) & 0xB400u);
+			q += (int32_t)(lfsr & 0xFF) - 128;
+		}
+		q = q > 0 ? q : 0;
+		q = q < 0xFFFF ? q : 0xFFFF;
+		q >>= 8;
+		err = y - (q << 8);
+		err = err < 0x200 ? err : 0x200;	// Limit windup at the ends of the range
+		err = err > -0x200 ? err : -0x200;
+		return q;
+	}
+
+	void reset()					{ err = 0; }
+
+protected:
+
+	int32_t err;		// Error carried to the next sample (1/256 steps)
+	uint16_t lfsr;		// Noise generator state
+	bool noise;			// Whether to add noise before quantizing
+};
+
+#endif
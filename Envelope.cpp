@@ -4,12 +4,12 @@
 #define ADSR8_DFLT_SUS 127
 
 ADSR8::ADSR8() :
-state(ADSRStateIdle), int_value(0), value(0), slope(0), phase(0), len(0), 
+state(ADSRStateIdle),
 atk_len(ADSR8_DFLT_LEN), dec_len(ADSR8_DFLT_LEN), 
 sus_lev(ADSR8_DFLT_SUS), rel_len(ADSR8_DFLT_LEN),
-retrigger(false),
+retrigger(false), atk_curve(0), dec_curve(0), rel_curve(0),
 eod_handler(NULL), eod_userdata(NULL), eor_handler(NULL), eor_userdata(NULL) {
-
+	ramp.len = 0;
 }
 
 ADSR8::~ADSR8() {
@@ -18,28 +18,20 @@ ADSR8::~ADSR8() {
 
 void ADSR8::set_attack(uint32_t p_len) {
 	atk_len = p_len < ADSR8_LEN_MAX ? p_len : ADSR8_LEN_MAX;
-	if (state == ADSRStateAttack) {
-		len = atk_len - phase;
-		len = len > MIN_RECOMP_LEN ? len : MIN_RECOMP_LEN;
-		compute_slope(value, ATK_LEVEL, len);
-	}
+	if (state == ADSRStateAttack)
+		recompute(ATK_LEVEL, atk_len);
 }
 
 void ADSR8::set_decay(uint32_t p_len) {
 	dec_len = p_len < ADSR8_LEN_MAX ? p_len : ADSR8_LEN_MAX;
-	if (state == ADSRStateDecay) {
-		len = dec_len - phase;
-		len = len > MIN_RECOMP_LEN ? len : MIN_RECOMP_LEN;
-		compute_slope(value, sus_lev, len);
-	}
+	if (state == ADSRStateDecay)
+		recompute(sus_lev, dec_len);
 }
 
-void ADSR8::set_sustain(uint8_t p_lev) {
+void ADSR8::set_sustain(uint16_t p_lev) {
 	sus_lev = p_lev < ADSR8_LEV_MAX ? p_lev : ADSR8_LEV_MAX;
 	if (state == ADSRStateDecay) {
-		len = dec_len - phase;
-		len = len > MIN_RECOMP_LEN ? len : MIN_RECOMP_LEN;
-		compute_slope(value, sus_lev, len);
+		recompute(sus_lev, dec_len);
 	}
 	else if (state == ADSRStateSustain) {
 		begin_sustain_adjust();
@@ -48,91 +40,126 @@ void ADSR8::set_sustain(uint8_t p_lev) {
 
 void ADSR8::set_release(uint32_t p_len) {
 	rel_len = p_len < ADSR8_LEN_MAX ? p_len : ADSR8_LEN_MAX;
-	if (state == ADSRStateRelease) {
-		len = rel_len - phase;
-		len = len > MIN_RECOMP_LEN ? len : MIN_RECOMP_LEN;
-		compute_slope(value, REL_LEVEL, len);
-	}
+	if (state == ADSRStateRelease)
+		recompute(REL_LEVEL, rel_len);
 }
 
-void ADSR8::compute_slope(SQ9x22 x0, SQ9x22 x1, int32_t new_len) {
-	len = new_len;
-	slope = x1 - x0;
-	slope = static_cast<float>(slope) / (float)len;
+void ADSR8::save(Preset &p) {
+	p.put(atk_len);
+	p.put(dec_len);
+	p.put((uint16_t)sus_lev.getInteger());
+	p.put(rel_len);
+	p.put(retrigger);
+	p.put(ramp.control_period());
+	p.put(atk_curve);
+	p.put(dec_curve);
+	p.put(rel_curve);
 }
 
-uint16_t ADSR8::render() {
-	if (state == ADSRStateIdle) {
-		return 0;
-	}
-	if (state == ADSRStateSustain) {
-		return (int16_t)sus_lev.getInteger();
-	}
-	if (phase >= len) {
-		switch (state) {
-			case ADSRStateAttack:
-				begin_decay();
-				break;
-			case ADSRStateDecay:
-				if (retrigger) 	
-					begin_attack();
-				else 			
-					begin_sustain();				
-				if (eod_handler)
-					eod_handler(eod_userdata);
-				break;
-			case ADSRStateSustainAdjust:
-				begin_sustain();
-				break;
-			case ADSRStateRelease:
-				begin_idle();
-				if (eor_handler)
-					eor_handler(eor_userdata);
-				break;
-			default:
-				break;		
+bool ADSR8::load(Preset &p) {
+	int32_t atk, dec, rel;
+	uint16_t sus, ctl;
+	bool retrig;
+	int8_t atk_c, dec_c, rel_c;
+	if (!(p.get(atk) && p.get(dec) && p.get(sus) && p.get(rel) && p.get(retrig) && p.get(ctl)
+		&& p.get(atk_c) && p.get(dec_c) && p.get(rel_c)))
+		return false;
+	set_attack(atk);
+	set_decay(dec);
+	set_sustain(sus);
+	set_release(rel);
+	set_retrigger(retrig);
+	set_control_period(ctl);
+	set_attack_curve(atk_c);
+	set_decay_curve(dec_c);
+	set_release_curve(rel_c);
+	return true;
+}
+
+void ADSR8::recompute(GenFixed x1, int32_t new_len) {
+	int32_t len = new_len - ramp.phase;
+	ramp.len = len > MIN_RECOMP_LEN ? len : MIN_RECOMP_LEN;
+	ramp.compute_slope(x1, ramp.len);
+}
+
+void ADSR8::advance(int32_t n) {
+	int32_t k;
+	while (n > 0) {
+		if (state == ADSRStateIdle || state == ADSRStateSustain)
+			return;
+		if (ramp.phase >= ramp.len) {
+			switch (state) {
+				case ADSRStateAttack:
+					begin_decay();
+					break;
+				case ADSRStateDecay:
+					if (retrigger) 	
+						begin_attack();
+					else 			
+						begin_sustain();				
+					if (eod_handler)
+						eod_handler(eod_userdata);
+					break;
+				case ADSRStateSustainAdjust:
+					begin_sustain();
+					break;
+				case ADSRStateRelease:
+					begin_idle();
+					if (eor_handler)
+						eor_handler(eor_userdata);
+					break;
+				default:
+					break;		
+			}
+			if (state == ADSRStateIdle || state == ADSRStateSustain)
+				return;
 		}
+		k = ramp.remaining(n);
+		ramp.move(k);
+		ramp.phase += k;
+		n -= k;
+	}
+}
+
+void ADSR8::tick() {
+	int32_t n = ramp.control_samples();
+	if (n) {
+		advance(n);
+		ramp.interpolate(level());
 	}
-	value += slope;
-	int_value = (int16_t)value.getInteger();
-	int_value = int_value > ADSR8_LEV_MIN ? int_value : ADSR8_LEV_MIN;
-	int_value = int_value < ADSR8_LEV_MAX ? int_value : ADSR8_LEV_MAX;
-	phase++;
-	return int_value;
+	ramp.next();
 }
 
 void ADSR8::begin_idle() {
-	phase = 0;
+	ramp.phase = 0;
 	state = ADSRStateIdle;
 }
 
 void ADSR8::begin_attack() {
-	phase = 0;
 	state = ADSRStateAttack;
-	compute_slope(value, ATK_LEVEL, atk_len);
+	ramp.set_curve(atk_curve);
+	ramp.begin(ATK_LEVEL, atk_len);
 }
 
 void ADSR8::begin_decay() {
-	phase = 0;
 	state = ADSRStateDecay;
-	compute_slope(value, sus_lev, dec_len);
+	ramp.set_curve(dec_curve);
+	ramp.begin(sus_lev, dec_len);
 }
 
 void ADSR8::begin_sustain() {
-	phase = 0;
+	ramp.phase = 0;
 	state = ADSRStateSustain;
 }
 
 void ADSR8::begin_sustain_adjust() {
-	phase = 0;
 	state = ADSRStateSustainAdjust;
-	compute_slope(value, sus_lev, MIN_RECOMP_LEN);
+	ramp.set_curve(0);
+	ramp.begin(sus_lev, MIN_RECOMP_LEN);
 }
 
 void ADSR8::begin_release() {
-	phase = 0;
 	state = ADSRStateRelease;
-	compute_slope(value, REL_LEVEL, rel_len);
-}
-
-	
\ No newline at end of file
+	ramp.set_curve(rel_curve);
+	ramp.begin(REL_LEVEL, rel_len);
+}
\ No newline at end of file
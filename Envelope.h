@@ -4,22 +4,21 @@
 #ifndef ADSR_H
 #define ADSR_H
 
-#include <FixedPoints.h>
-#include <FixedPointsCommon.h>
+#include "Ramp.h"
+#include "Timebase.h"
+#include "Preset.h"
 
-#define ADSR8_LEN_MAX 2147483647
-#define ADSR8_LEV_MAX 255
-#define ADSR8_LEV_MIN 0
-
-using SQ9x22 = SFixed<9, 22>;
+#define ADSR8_LEN_MAX GEN_LEN_MAX
+#define ADSR8_LEV_MAX GEN_LEV_MAX
+#define ADSR8_LEV_MIN GEN_LEV_MIN
 
 class ADSR8 {
 
 	// Minimum number of samples used to recompute the length of a state when
 	// the length is changed during the state
 	const int MIN_RECOMP_LEN = 8;
-	const SQ9x22 ATK_LEVEL = ADSR8_LEV_MAX;
-	const SQ9x22 REL_LEVEL = ADSR8_LEV_MIN;
+	const GenFixed ATK_LEVEL = ADSR8_LEV_MAX;
+	const GenFixed REL_LEVEL = ADSR8_LEV_MIN;
 
 	enum {
 		ADSRStateIdle = 0,
@@ -39,10 +38,31 @@ public:
 	// Parameter setters
 	void set_attack(uint32_t len);
 	void set_decay(uint32_t len);
-	void set_sustain(uint8_t level);
+	void set_sustain(uint16_t level);
 	void set_release(uint32_t len);
 	void set_retrigger(bool retrig)	{ retrigger = retrig; }
 
+	// Segment shapes: curvature [-CURVE_MAX, CURVE_MAX], 0 for linear (see
+	// Curve.h); positive curves move fast first, like an analog envelope.
+	// Take effect at the next segment.
+	void set_attack_curve(int8_t c)		{ atk_curve = curve_prepare(c); }
+	void set_decay_curve(int8_t c)		{ dec_curve = curve_prepare(c); }
+	void set_release_curve(int8_t c)	{ rel_curve = curve_prepare(c); }
+
+	// Parameter setters in milliseconds
+	void set_attack(UQ16x16 ms, const Timebase &tb)		{ set_attack(tb.ms_to_samples(ms)); }
+	void set_decay(UQ16x16 ms, const Timebase &tb)		{ set_decay(tb.ms_to_samples(ms)); }
+	void set_release(UQ16x16 ms, const Timebase &tb)	{ set_release(tb.ms_to_samples(ms)); }
+
+	// Update state every n samples (rounded down to a power of two, up to 256)
+	// and linearly interpolate the samples in between; 1 updates every sample
+	void set_control_period(uint16_t n)	{ ramp.set_control_period(n); }
+
+	// Append the parameters to a preset / restore them; load() changes
+	// nothing and returns false if the preset is too short
+	void save(Preset &p);
+	bool load(Preset &p);
+
 	// Setters for user callbacks on end of Decay and Release
 	void set_eod_handler(void (*handler)(void *), void *userdata) {
 		eod_handler = handler;
@@ -59,14 +79,28 @@ public:
 		else			begin_release();
 	}
 
-	// Render
-	uint16_t render();
+	// Render the next sample [0-ADSR8_LEV_MAX], or the same sample with
+	// GenRamp::FINE_SHIFT fractional bits (for a Dither8 output stage)
+	uint16_t render()			{ tick(); return ramp.level(); }
+	uint16_t render_fine()		{ tick(); return ramp.fine_level(); }
 
 protected:
 
-	// Compute a slope to reach x1 from x0 in new_len samples; 
-	// sets current state length
-	void compute_slope(SQ9x22 x0, SQ9x22 x1, int32_t new_len);
+	// Recompute the slope to x1 when the current state's length changes
+	void recompute(GenFixed x1, int32_t new_len);
+
+	// Advance n samples, through state changes if needed
+	void advance(int32_t n);
+
+	// Move the output one sample, advancing state once per control period
+	void tick();
+
+	// Current output level
+	GenFixed level() {
+		if (state == ADSRStateIdle)		return REL_LEVEL;
+		if (state == ADSRStateSustain)	return sus_lev;
+		return ramp.value;
+	}
 
 	// Begin states
 	void begin_idle();
@@ -78,20 +112,19 @@ protected:
 
 	uint8_t state;					// Current state
 
-	SQ9x22 value;					// Current fixed point value
-	SQ9x22 slope;					// Current fixed point slope
-	int16_t int_value;				// Current value, casted and constrained to [0, 255]
-	
-	int32_t phase;					// Current state's phase
-	int32_t len;					// Current state's length
+	GenRamp ramp;					// Value, slope, phase and output of the current state
 
 	int32_t atk_len;				// Attack state length
 	int32_t dec_len;				// Decay state length
-	SQ9x22 sus_lev;					// Sustain state target level
+	GenFixed sus_lev;				// Sustain state target level
 	int32_t rel_len;				// Release state length
 
 	bool retrigger;					// Whether to retrigger attack on end of decay
 
+	int8_t atk_curve;				// Segment curvatures
+	int8_t dec_curve;
+	int8_t rel_curve;
+
 	void (*eod_handler)(void *);	// User callback for end of decay
 	void *eod_userdata;				// - its userdata
 	void (*eor_handler)(void *);	// User callback for end of release
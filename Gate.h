@@ -20,7 +20,13 @@ class Gate {
 public:
 
 	Gate(int dflt_min, int dflt_max, int eeprom_addr, Stream *debug_serial) 
-	: 	dflt_min(dflt_min), 
+	: 	value(0),
+		state(false),
+		n_samples(0),
+		edge_time(0),
+		edge_handler(NULL),
+		edge_userdata(NULL),
+		dflt_min(dflt_min), 
 		dflt_max(dflt_max), 
 		eeprom_addr(eeprom_addr),  
 		debug_serial(debug_serial) {}
@@ -44,12 +50,36 @@ public:
 
 	// Get the current state 
 	bool get_state() { return cal.invert ? !state : state; }
-	bool get_value() { return value; }
+	int get_value() { return value; }
+
+	// Set callback for state changes, called from process() with the new state;
+	// process() can run in the render callback, so the handler acts on the
+	// sample the edge was detected. Both are set with interrupts off, so it
+	// never sees a new handler with the old userdata
+	void set_edge_handler(void (*handler)(bool, void *), void *userdata) {
+		noInterrupts();
+		edge_handler = handler;
+		edge_userdata = userdata;
+		interrupts();
+	}
+
+	// Bind state changes to a generator's gate(bool) (e.g. ADSR8, SEQ8)
+	template <class G>
+	void bind_gate(G &gen)		{ set_edge_handler(call_gate<G>, &gen); }
+
+	// Bind rising edges to a generator's reset() (e.g. SEQ8)
+	template <class G>
+	void bind_reset(G &gen)		{ set_edge_handler(call_reset<G>, &gen); }
+
+	// Sample index (count of process() calls) of the last state change
+	uint32_t get_edge_time() { return edge_time; }
+	uint32_t samples_since_edge() { return n_samples - edge_time; }
 
 	// Process a new sample, return true if state changes
 	bool process(int val) {
 		bool update = false;
 		value = val;
+		n_samples++;
 		if (state == true && value < cal.low) {
 		    state = false;
 		    update = true;
@@ -58,6 +88,20 @@ public:
 		    state = true;
 		    update = true;
 		}
+		if (update) {
+			edge_time = n_samples;
+			if (edge_handler)
+				edge_handler(get_state(), edge_userdata);
+		}
+		return update;
+	}
+
+	// Process a block of samples (e.g. from AnalogInput), return true if state
+	// changes anywhere in the block
+	bool process(const uint16_t *x, uint16_t n) {
+		bool update = false;
+		for (uint16_t i = 0; i < n; i++)
+			update |= process((int)x[i]);
 		return update;
 	}
 
@@ -70,8 +114,8 @@ protected:
 		int min = range > 0 ? cal.min : cal.max;
 		cal.invert = range < 0;
 		range = abs(range);
-		cal.low = min + range / 3.0;
-		cal.high = min + 2 * range / 3.0;
+		cal.low = min + range / 3;
+		cal.high = min + 2 * range / 3;
 
 		if (debug_serial) {
 			debug_serial->println("Saving calibration:");
@@ -106,6 +150,15 @@ protected:
 		return success;
 	}
 
+	template <class G>
+	static void call_gate(bool high, void *gen)		{ ((G *)gen)->gate(high); }
+
+	template <class G>
+	static void call_reset(bool high, void *gen) {
+		if (high)
+			((G *)gen)->reset();
+	}
+
 	void print_calibration() {
 		debug_serial->print("cal.min = ");
 		debug_serial->println(cal.min);
@@ -121,6 +174,10 @@ protected:
 
 	int value;
 	bool state;
+	uint32_t n_samples;						// Samples processed
+	uint32_t edge_time;						// Sample of the last state change
+	void (*edge_handler)(bool, void *);		// User callback for state changes
+	void *edge_userdata;					// - its userdata
 	struct GateCalibration cal;
 	int dflt_min;
 	int dflt_max;
@@ -0,0 +1,17 @@
+/*
+ *	GenLevels.h
+ */
+#ifndef GENLEVELS_H
+#define GENLEVELS_H
+
+// Output resolution of the generators (LFO8, ADSR8, SEQ8); define as 10, 12 or
+// 16 for DAC/PWM backends wider than the 8-bit sigma-delta channel
+#ifndef GEN_OUTPUT_BITS
+#define GEN_OUTPUT_BITS 8
+#endif
+
+#define GEN_LEN_MAX 2147483647
+#define GEN_LEV_MAX ((1L << GEN_OUTPUT_BITS) - 1)
+#define GEN_LEV_MIN 0
+
+#endif
@@ -0,0 +1,98 @@
+#include "LoadGovernor.h"
+
+LoadGovernor::LoadGovernor(uint8_t budget_pct) :
+budget(budget_pct), rate(0), cycles_per_tick(0), window_ticks(0xFFFFFFFF),
+t_begin(0), interval(0), win_cycles(0), win_peak(0), win_ticks(0), win_missed(0),
+done_cycles(0), done_peak(0), done_ticks(0), done_missed(0), done(false),
+lvl(0), n_low(0), last_load(0), last_peak(0), n_missed(0),
+level_handler(NULL), level_userdata(NULL) {
+
+}
+
+#ifdef ARDUINO
+uint32_t LoadGovernor::calibrate(void (*render)(void *), void *arg, const uint32_t *rates, uint8_t n) {
+	uint64_t total = 0;
+	uint32_t cpu_hz = ESP.getCpuFreqMHz() * 1000000;
+	for (int i = 0; i < LG_CALIBRATION_TICKS; i++) {
+		uint32_t t0 = ESP.getCycleCount();
+		render(arg);
+		total += ESP.getCycleCount() - t0;
+	}
+	uint32_t mean = total / LG_CALIBRATION_TICKS;
+
+	// Highest rate at which the mean cost fits the budget
+	uint8_t i;
+	for (i = 0; i + 1 < n; i++) {
+		if ((uint64_t)mean * rates[i] * 100 <= (uint64_t)cpu_hz * budget)
+			break;
+	}
+	return n ? rates[i] : 0;
+}
+
+void LoadGovernor::start(ETSTimer *timer, void (*render)(void *), void *arg, uint32_t rate) {
+	ets_timer_disarm(timer);
+	set_rate(rate, ESP.getCpuFreqMHz() * 1000000);
+	ets_timer_setfn(timer, render, arg);
+	t_begin = ESP.getCycleCount();
+	ets_timer_arm_new(timer, 1000000 / rate, true, 0);
+}
+#endif
+
+void LoadGovernor::set_rate(uint32_t sample_rate, uint32_t cpu_hz) {
+	rate = sample_rate > 0 ? sample_rate : 1;
+	cycles_per_tick = cpu_hz / rate;
+	window_ticks = rate * LG_WINDOW_MS / 1000;
+	window_ticks = window_ticks > 0 ? window_ticks : 1;
+	win_cycles = win_peak = win_missed = 0;
+	win_ticks = 0;
+	done = false;
+}
+
+bool LoadGovernor::loop() {
+	if (!done)
+		return false;
+
+	// Take the finished window
+#ifdef ARDUINO
+	noInterrupts();
+#endif
+	uint32_t cycles = done_cycles;
+	uint32_t peak_cycles = done_peak;
+	uint32_t ticks = done_ticks;
+	uint32_t missed_ticks = done_missed;
+	done = false;
+#ifdef ARDUINO
+	interrupts();
+#endif
+
+	if (!cycles_per_tick || !ticks)
+		return false;
+	uint64_t load = (uint64_t)cycles * 1000 / ((uint64_t)ticks * cycles_per_tick);
+	uint64_t peak = (uint64_t)peak_cycles * 1000 / cycles_per_tick;
+	last_load = load < 0xFFFF ? load : 0xFFFF;		// A stalled tick can exceed 65x
+	last_peak = peak < 0xFFFF ? peak : 0xFFFF;
+	n_missed += missed_ticks;
+
+	// Degrade at once when overloaded, recover slowly
+	uint8_t new_lvl = lvl;
+	if (last_load >= LG_HIGH_LOAD * 10 || missed_ticks * 100 > ticks * LG_MISSED_PCT) {
+		n_low = 0;
+		if (lvl < LG_MAX_LEVEL)
+			new_lvl = lvl + 1;
+	}
+	else if (lvl > 0 && (last_load << LG_LEVEL_SHIFT) < LG_HIGH_LOAD * 10) {
+		if (++n_low >= LG_RECOVER_WINDOWS) {
+			n_low = 0;
+			new_lvl = lvl - 1;
+		}
+	}
+	else 
+		n_low = 0;
+
+	if (new_lvl == lvl)
+		return false;
+	lvl = new_lvl;
+	if (level_handler)
+		level_handler(lvl, level_userdata);
+	return true;
+}
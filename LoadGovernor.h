@@ -0,0 +1,136 @@
+/*
+ *	LoadGovernor.h
+ */
+#ifndef LOADGOVERNOR_H
+#define LOADGOVERNOR_H
+
+#ifdef ARDUINO
+#include "Arduino.h"
+extern "C" {
+#include "ets_sys.h"
+}
+#else
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+// Defaults
+#define LG_DFLT_BUDGET 50			// % of the sample period render may take at startup
+#define LG_CALIBRATION_TICKS 256	// Render calls timed by calibrate()
+#define LG_WINDOW_MS 125			// Load is evaluated over windows of this length
+#define LG_HIGH_LOAD 75				// % mean load in a window that raises the level
+#define LG_RECOVER_WINDOWS 8		// Windows in a row under it (at the lower level) to lower it
+#define LG_MISSED_PCT 1				// % missed ticks in a window that raises the level
+#define LG_MAX_LEVEL 4				// Control period 1 << (2 * level): 1 to 256
+#define LG_LEVEL_SHIFT 2
+
+// Measures the render callback's cost per tick and keeps it within the sample
+// period. At startup, calibrate() times the render function and picks the
+// highest sample rate whose cost fits a budget, leaving the rest of the period
+// to WiFi and loop(). While running, begin() and end() bracket each tick; the
+// mean load and missed ticks (intervals over 1.5 periods) are evaluated per
+// window in loop(), which raises the degrade level when a window is overloaded
+// and lowers it again once the load, scaled up by the control period ratio,
+// has stayed under the limit (so it doesn't flap). The level handler applies
+// it, e.g. as a generator control period (see control_period()), so an
+// overloaded node renders coarser instead of dropping ticks.
+class LoadGovernor {
+
+public:
+
+	LoadGovernor(uint8_t budget_pct = LG_DFLT_BUDGET);
+
+#ifdef ARDUINO
+	// Time the render function and return the highest of n sample rates
+	// (highest first) at which it fits the budget, or the last rate. The
+	// render function is called LG_CALIBRATION_TICKS times, so call this
+	// before the sample timer is armed.
+	uint32_t calibrate(void (*render)(void *), void *arg, const uint32_t *rates, uint8_t n);
+
+	// (Re)arm the sample timer at a rate and start measuring
+	void start(ETSTimer *timer, void (*render)(void *), void *arg, uint32_t rate);
+
+	// Bracket the render callback's work
+	void begin() {
+		uint32_t t = ESP.getCycleCount();
+		interval = t - t_begin;
+		t_begin = t;
+	}
+	void end()							{ record(ESP.getCycleCount() - t_begin, interval); }
+#endif
+
+	// Rate of the measured ticks and the CPU clock (cycles per second)
+	void set_rate(uint32_t rate, uint32_t cpu_hz);
+
+	// Account one tick that took the given cycles, after the given cycles since
+	// the previous one (render callback)
+	void record(uint32_t cycles, uint32_t since_last) {
+		win_cycles += cycles;
+		if (cycles > win_peak)
+			win_peak = cycles;
+		if (cycles_per_tick && since_last > cycles_per_tick + (cycles_per_tick >> 1))
+			win_missed += (since_last + (cycles_per_tick >> 1)) / cycles_per_tick - 1;
+		if (++win_ticks >= window_ticks) {
+			done_cycles = win_cycles;
+			done_peak = win_peak;
+			done_ticks = win_ticks;
+			done_missed = win_missed;
+			done = true;
+			win_cycles = win_peak = win_missed = 0;
+			win_ticks = 0;
+		}
+	}
+
+	// Evaluate finished windows and call the level handler on a change; call
+	// from loop(). Returns true if the level changed.
+	bool loop();
+
+	// Set the function called with the new level [0-LG_MAX_LEVEL]
+	void set_level_handler(void (*handler)(uint8_t, void *), void *userdata) {
+		level_handler = handler;
+		level_userdata = userdata;
+	}
+
+	// Degrade level, and the generator control period it suggests
+	uint8_t level()						{ return lvl; }
+	uint16_t control_period()			{ return 1 << (lvl * LG_LEVEL_SHIFT); }
+
+	// Last window's mean and peak load (1/1000 of the sample period), and the
+	// ticks missed since the start; loads are capped at 65535
+	uint16_t load()						{ return last_load; }
+	uint16_t peak()						{ return last_peak; }
+	uint32_t missed()					{ return n_missed; }
+
+	uint32_t sample_rate()				{ return rate; }
+
+protected:
+
+	uint8_t budget;
+	uint32_t rate;
+	uint32_t cycles_per_tick;
+	uint32_t window_ticks;
+
+	// Render callback accumulators, and the last finished window
+	uint32_t t_begin;
+	uint32_t interval;
+	uint32_t win_cycles;
+	uint32_t win_peak;
+	uint32_t win_ticks;
+	uint32_t win_missed;
+	uint32_t done_cycles;
+	uint32_t done_peak;
+	uint32_t done_ticks;
+	uint32_t done_missed;
+	volatile bool done;
+
+	uint8_t lvl;
+	uint8_t n_low;				// Consecutive low-load windows
+	uint16_t last_load;
+	uint16_t last_peak;
+	uint32_t n_missed;
+
+	void (*level_handler)(uint8_t, void *);
+	void *level_userdata;
+};
+
+#endif
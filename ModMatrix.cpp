@@ -0,0 +1,68 @@
+#include "ModMatrix.h"
+
+ModMatrix::ModMatrix() :
+block_len(MODMATRIX_DFLT_BLOCK_LEN), count(0), n_sources(0), n_dests(0) {
+	clear();
+}
+
+int ModMatrix::add_source(const volatile uint16_t *value) {
+	if (n_sources >= MODMATRIX_MAX_SOURCES)
+		return -1;
+	sources[n_sources] = value;
+	return n_sources++;
+}
+
+int ModMatrix::add_destination(void (*setter)(int32_t, void *), void *userdata, 
+	int32_t base, int32_t min, int32_t max) {
+	if (n_dests >= MODMATRIX_MAX_DESTS)
+		return -1;
+	mod_dest_t &d = dests[n_dests];
+	d.setter = setter;
+	d.userdata = userdata;
+	d.base = base;
+	d.min = min;
+	d.max = max;
+	d.last = base - 1;		// Force the first update
+	return n_dests++;
+}
+
+void ModMatrix::set_base(uint8_t dst, int32_t base) {
+	if (dst < n_dests)
+		dests[dst].base = base;
+}
+
+bool ModMatrix::set_route(uint8_t idx, uint8_t src, uint8_t dst, int16_t amount) {
+	if (idx >= MODMATRIX_MAX_ROUTES)
+		return false;
+	if (amount && (src >= n_sources || dst >= n_dests))
+		return false;
+	routes[idx] = (uint32_t)(uint16_t)amount << 16 | (uint32_t)dst << 8 | src;
+	return true;
+}
+
+void ModMatrix::process() {
+
+	int i;
+	for (i = 0; i < n_dests; i++)
+		sums[i] = 0;
+
+	// Accumulate modulation in destination units (8 fractional bits)
+	for (i = 0; i < MODMATRIX_MAX_ROUTES; i++) {
+		mod_route_t r = routes[i];
+		int16_t amount = r >> 16;
+		if (amount)
+			sums[(r >> 8) & 0xFF] += (int32_t)*sources[r & 0xFF] * amount;
+	}
+
+	// Update destinations whose value changed
+	for (i = 0; i < n_dests; i++) {
+		mod_dest_t &d = dests[i];
+		int32_t x = d.base + (sums[i] >> 8);
+		x = x > d.min ? x : d.min;
+		x = x < d.max ? x : d.max;
+		if (x != d.last) {
+			d.last = x;
+			d.setter(x, d.userdata);
+		}
+	}
+}
@@ -0,0 +1,97 @@
+/*
+ *	ModMatrix.h
+ */
+#ifndef MODMATRIX_H
+#define MODMATRIX_H
+
+#include "Arduino.h"
+
+// Allow user redefinition of table sizes
+#ifndef MODMATRIX_MAX_SOURCES
+#define MODMATRIX_MAX_SOURCES 8
+#endif
+#ifndef MODMATRIX_MAX_DESTS
+#define MODMATRIX_MAX_DESTS 8
+#endif
+#ifndef MODMATRIX_MAX_ROUTES
+#define MODMATRIX_MAX_ROUTES 16
+#endif
+
+// Defaults
+#define MODMATRIX_DFLT_BLOCK_LEN 32
+
+// Route amounts are fixed point with 8 fractional bits: destination units per
+// source unit, so 256 adds the source value (0-255) to the destination as is
+#define MODMATRIX_UNITY 256
+
+// Modulation matrix: routes generator outputs (sources) to parameter setters
+// (destinations) with a fixed-point amount, evaluated once per control block.
+// tick() runs in the render callback, so destination setters must be short
+// and integer-only (the LFO8/ADSR8/SEQ8 length and level setters are).
+class ModMatrix {
+
+	typedef struct mod_dest_t {
+		void (*setter)(int32_t, void *);	// Called with the modulated value
+		void *userdata;						// - its userdata
+		int32_t base;						// Unmodulated value
+		int32_t min;						// Modulated value range
+		int32_t max;
+		int32_t last;						// Last value passed to the setter
+	} mod_dest_t;
+
+	// Routes are packed into one word (amount << 16 | dst << 8 | src) so
+	// set_route() publishes a whole route to the render callback in one store;
+	// an amount of 0 disables the route
+	typedef uint32_t mod_route_t;
+
+public:
+
+	ModMatrix();
+
+	// Register a source (usually a variable holding a generator's last output);
+	// returns its index or -1 if the table is full
+	int add_source(const volatile uint16_t *value);
+
+	// Register a destination with its unmodulated value and allowed range;
+	// returns its index or -1 if the table is full
+	int add_destination(void (*setter)(int32_t, void *), void *userdata, 
+		int32_t base, int32_t min, int32_t max);
+
+	// Set a destination's unmodulated value
+	void set_base(uint8_t dst, int32_t base);
+
+	// Set route idx from src to dst; return false if any index is invalid
+	bool set_route(uint8_t idx, uint8_t src, uint8_t dst, int16_t amount);
+	void clear_route(uint8_t idx)	{ set_route(idx, 0, 0, 0); }
+	void clear()					{ for (int i = 0; i < MODMATRIX_MAX_ROUTES; i++) clear_route(i); }
+
+	// Number of samples per control block
+	void set_block_length(uint16_t n)	{ block_len = n > 0 ? n : 1; }
+
+	// Call once per sample from the render callback
+	void tick() {
+		if (++count >= block_len) {
+			count = 0;
+			process();
+		}
+	}
+
+	// Evaluate all routes and update changed destinations
+	void process();
+
+protected:
+
+	uint16_t block_len;			// Samples per control block
+	uint16_t count;				// Samples since the last evaluation
+
+	const volatile uint16_t *sources[MODMATRIX_MAX_SOURCES];
+	uint8_t n_sources;
+
+	mod_dest_t dests[MODMATRIX_MAX_DESTS];
+	uint8_t n_dests;
+
+	volatile mod_route_t routes[MODMATRIX_MAX_ROUTES];
+	int32_t sums[MODMATRIX_MAX_DESTS];		// Per-block modulation accumulators
+};
+
+#endif
@@ -5,14 +5,50 @@ static int pad_len(int bytes) {
 	return (4 - (bytes & 03)) & 3; 
 }
 
+// Looper and playout buffer entry header, followed by the message bytes 
+// (padded to 4)
+struct LoopEvent {
+	uint32_t time;		// Samples from the start of the loop, or playout clock
+	uint16_t len;		// Message bytes
+	uint16_t reserved;
+};
+
+// Collects an outgoing message for UDPQueue::send()
+class OSCPacketWriter : public Print {
+public:
+	OSCPacketWriter(uint8_t *buffer, size_t size) : data(buffer), size(size), len(0), overflow(false) {}
+	size_t write(uint8_t b) {
+		if (len >= size) {
+			overflow = true;
+			return 0;
+		}
+		data[len++] = b;
+		return 1;
+	}
+	uint8_t *data;
+	size_t size;
+	size_t len;
+	bool overflow;
+};
+
 // ============================================================================
-OSCManager::OSCManager() {
-	OSCManager(NULL);
+OSCManager::OSCManager() : OSCManager(NULL) {
+
 }
 
 OSCManager::OSCManager(Stream *debug_serial) : debug_serial(debug_serial), 
-local_port(NULL), dest_port(NULL), dest_address(NULL), num_handlers(0) {
-	
+queue(NULL), queue_addr(0), queue_port(0),
+local_port(NULL), dest_port(NULL), dest_address(NULL), num_handlers(0),
+num_fast_handlers(0),
+clock(0), looper(OSCLoopIdle), replaying(false), loop_start(0), loop_len(0), 
+loop_used(0), loop_cursor(0), loop_buffer(NULL), loop_size(0),
+playout(false), playout_rate(0), playout_fixed(0), playout_synced(false), 
+playout_base(0), delay_q4(0), jitter_q4(0), peak_q4(0), playout_used(0),
+playout_buffer(NULL), playout_size(0), arrival(0), arrival_set(false),
+n_checks(0), clock_sync(NULL), beacon_address(255, 255, 255, 255), 
+beacon_port(0), beacon_ports(1), beacon_time(0) {
+	reset_stats();
+	memset(senders, 0, sizeof(senders));
 }
 
 OSCManager::~OSCManager() {
@@ -21,7 +57,7 @@ OSCManager::~OSCManager() {
 
 bool OSCManager::open_port(uint16_t port) {
 	local_port = dest_port = port;
-	if (udp_local.begin(local_port) == 1) {
+	if (queue ? queue->begin(local_port) : udp_local.begin(local_port) == 1) {
 		if (debug_serial)
 			debug_serial->printf("Listening for OSC on port %d\n", local_port);
 		return true;
@@ -34,75 +70,625 @@ void OSCManager::set_dest(IPAddress addr, uint16_t port) {
 	dest_port = port;
 }
 
-void OSCManager::dispatch(char *path, void (*handler)(OSCMessage &)) {
+void OSCManager::dispatch(char *path, void (*handler)(OSCMessage &), bool is_loopable) {
 	strcpy(paths[num_handlers], path);
 	handlers[num_handlers] = handler;
+	loopable[num_handlers] = is_loopable;
 	num_handlers++;
 }
 
-bool OSCManager::loop() {
+void OSCManager::set_queue(UDPQueue *udp_queue) {
+	queue = udp_queue;
+	if (queue)
+		queue->set_fast_handler(receive_fast, this);
+}
+
+void OSCManager::dispatch_fast(char *path, void (*handler)(OSCMessage &), bool is_loopable) {
+	strcpy(fast_paths[num_fast_handlers], path);
+	fast_handlers[num_fast_handlers] = handler;
+	fast_loopable[num_fast_handlers] = is_loopable;
+	num_fast_handlers++;
+
+	// Bundled and replayed messages still arrive through loop()
+	dispatch(path, handler, is_loopable);
+}
+
+bool OSCManager::loop(uint32_t budget_us) {
 
 	bool success = false;
-	int n_bytes = udp_local.parsePacket();
 
-	if (n_bytes) {
-		char *data = (char *)malloc(n_bytes * sizeof(char));
-		udp_local.read(data, n_bytes);		
+	// Replay recorded messages that are due
+	if (looper == OSCLoopPlay || looper == OSCLoopOverdub)
+		success = replay();
 
-		// Debug printing
-		print_udp("Data from UDP client", 
-			udp_local.remoteIP().toString().c_str(), 
-			udp_local.remotePort());
+	// Dispatch delayed messages that are due
+	if (playout_used)
+		success = play_out() || success;
+
+	// Beacon to the nodes following this clock
+	if (clock_sync && clock_sync->master() && local_port &&
+		millis() - beacon_time >= OSC_SYNC_BEACON_MS) 
+		send_beacon();
 
-		success = handle_buffer((uint8_t *)data, n_bytes);
+	// Drain received packets while the budget lasts, so bursts don't wait in
+	// lwIP (or the queue) for later calls
+	uint32_t start = micros();
+	if (queue) {
+		UDPPacket *packet;
+		while ((packet = queue->front())) {
+			queue_addr = packet->addr;
+			queue_port = packet->port;
+			// Arrival in samples, back-dated from the callback's time stamp
+			uint32_t waited = micros() - packet->time_us;
+			uint32_t arrived = clock - (uint32_t)((uint64_t)waited * playout_rate / 1000000);
+			success = receive(packet->data, packet->len, arrived) || success;
+			queue->pop();
+			if (micros() - start >= budget_us)
+				break;
+		}
+		return success;
+	}
+	int n_bytes;
+	while ((n_bytes = udp_local.parsePacket())) {
+		char *data = (char *)malloc(n_bytes * sizeof(char));
+		if (!data)
+			continue;		// parsePacket() drops it
+		udp_local.read(data, n_bytes);		
+		success = receive((uint8_t *)data, n_bytes, clock) || success;
 		free(data);
+		if (micros() - start >= budget_us)
+			break;
 	}
 	return success;
 }
 
+bool OSCManager::receive(uint8_t *data, size_t len, uint32_t arrived) {
+
+	// Debug printing
+	print_udp("Data from UDP client", 
+		remote_addr().toString().c_str(), 
+		remote_port());
+
+	uint32_t t0 = ESP.getCycleCount();
+	arrival = arrived;
+	arrival_set = true;
+	bool success = handle_buffer(data, len);
+	arrival_set = false;
+	stats.cycles += ESP.getCycleCount() - t0;
+	stats.packets++;
+	return success;
+}
+
+bool OSCManager::receive_fast(UDPPacket &packet, void *userdata) {
+	OSCManager *osc = (OSCManager *)userdata;
+	if (!osc->num_fast_handlers || !memchr(packet.data, 0, packet.len))
+		return false;
+
+	// Don't overtake messages still waiting for loop()
+	if (osc->queue->available())
+		return false;
+
+	// Compare the address before parsing, so other packets cost little here
+	int i;
+	for (i = 0; i < osc->num_fast_handlers; i++) {
+		if (strcmp((char *)packet.data, osc->fast_paths[i]) == 0)
+			break;
+	}
+	if (i == osc->num_fast_handlers)
+		return false;
+
+	// Sender, for handlers that reply (remote_addr(), remote_port())
+	osc->queue_addr = packet.addr;
+	osc->queue_port = packet.port;
+
+	OSCMessage msg;
+	msg.fill(packet.data, packet.len);
+	if (msg.hasError())
+		return false;		// Counted in loop()
+	osc->fast_handlers[i](msg);
+	osc->stats.fast++;
+	if (osc->fast_loopable[i])
+		osc->record_message(packet.data, packet.len);
+	return true;
+}
+
 void OSCManager::send(OSCMessage &msg) {
 	send(msg, dest_address);
 }
 
 void OSCManager::send(OSCMessage &msg, IPAddress dest) {
-	if (!dest_port)
+	send(msg, dest, dest_port);
+}
+
+void OSCManager::send(OSCMessage &msg, IPAddress dest, uint16_t port) {
+	if (!port)
 		return;
 
 	// Debug printing
 	print_udp("Sending UDP to client", 
 		dest.toString().c_str(), 
-		dest_port);
+		port);
 	print_osc_msg("OSC Message", msg);
 
-	udp_local.beginPacket(dest, dest_port);
+	if (queue) {
+		// Messages longer than a queue packet (e.g. a full Telemetry frame)
+		// are built on the heap
+		uint8_t buff[UDPQ_PACKET_LEN];
+		size_t size = msg.bytes();
+		uint8_t *data = size > sizeof(buff) ? (uint8_t *)malloc(size) : buff;
+		if (!data) {
+			stats.send_errors++;
+			return;
+		}
+		OSCPacketWriter packet(data, size > sizeof(buff) ? size : sizeof(buff));
+		msg.send(packet);
+		if (packet.overflow || !queue->send(packet.data, packet.len, (uint32_t)dest, port))
+			stats.send_errors++;
+		if (data != buff)
+			free(data);
+		return;
+	}
+	udp_local.beginPacket(dest, port);
 	msg.send(udp_local);
 	udp_local.endPacket();
 }
 
 bool OSCManager::handle_message(OSCMessage &msg) {
-	
+	return handle_message(msg, NULL);
+}
+
+bool OSCManager::handle_message(OSCMessage &msg, bool *is_loopable) {
+
+	if (is_loopable)
+		*is_loopable = false;
+
 	if (!msg.hasError())  { 
 
 		// Debug printing
 		print_osc_msg("OSC Message", msg);
 
 		// Dispatch to handler
-		for (int i = 0; i < num_handlers; i++) {
+		int i;
+		for (i = 0; i < num_handlers; i++) {
 			if (msg.dispatch(paths[i], handlers[i]))
 				break; 
 		}
+		if (i < num_handlers) {
+			stats.handled++;
+			if (is_loopable)
+				*is_loopable = loopable[i];
+		}
+		else
+			stats.unmatched++;
 	}
 	else {
 		OSCErrorCode error = msg.getError();
+		stats.errors++;
 		return false;
 	}
 	return true;
 }
 
 bool OSCManager::handle_buffer(uint8_t *bytes, size_t len) {
+	if (len >= 8 && memcmp(bytes, "#bundle", 8) == 0)
+		return handle_bundle(bytes, len);
 	OSCMessage msg; 
 	msg.fill(bytes, len);
-	return handle_message(msg);	
+	if (!msg.hasError() && (handle_sync(msg) || handle_loop_control(msg)))
+		return true;
+	bool record;
+	bool success = handle_message(msg, &record);
+	if (success && record && !replaying)
+		record_message(bytes, len);
+	return success;
+}
+
+// Looper:
+// ============================================================================
+void OSCManager::set_loop_buffer(uint8_t *buffer, uint16_t len) {
+	loop_clear();
+	loop_buffer = buffer;
+	loop_size = buffer ? len : 0;
+}
+
+void OSCManager::loop_record() {
+	if (!loop_buffer)
+		return;
+	looper = OSCLoopRecord;
+	loop_start = clock;
+	loop_len = 0;
+	loop_used = 0;
+	loop_cursor = 0;
+}
+
+void OSCManager::loop_play() {
+	if (looper == OSCLoopRecord) 
+		loop_len = clock - loop_start;
+	else if (looper == OSCLoopOverdub) {
+		looper = OSCLoopPlay;
+		return;
+	}
+	if (!loop_len) {
+		looper = OSCLoopIdle;
+		return;
+	}
+	looper = OSCLoopPlay;
+	loop_start = clock;
+	loop_cursor = 0;
+}
+
+void OSCManager::loop_overdub() {
+	if (looper != OSCLoopPlay)
+		loop_play();
+	if (looper == OSCLoopPlay)
+		looper = OSCLoopOverdub;
+}
+
+void OSCManager::loop_stop() {
+	if (looper == OSCLoopRecord)
+		loop_len = clock - loop_start;
+	looper = OSCLoopIdle;
+}
+
+void OSCManager::loop_clear() {
+	looper = OSCLoopIdle;
+	loop_len = 0;
+	loop_used = 0;
+	loop_cursor = 0;
+}
+
+bool OSCManager::handle_loop_control(OSCMessage &msg) {
+	if (!loop_buffer)
+		return false;
+	if (msg.fullMatch("/loop/record"))			loop_record();
+	else if (msg.fullMatch("/loop/play"))		loop_play();
+	else if (msg.fullMatch("/loop/overdub"))	loop_overdub();
+	else if (msg.fullMatch("/loop/stop"))		loop_stop();
+	else if (msg.fullMatch("/loop/clear"))		loop_clear();
+	else return false;
+	return true;
+}
+
+void OSCManager::record_message(uint8_t *bytes, size_t len) {
+	struct LoopEvent ev;
+	uint16_t at;
+	size_t size;
+
+	if (looper != OSCLoopRecord && looper != OSCLoopOverdub)
+		return;
+	size = sizeof(ev) + len + pad_len(len);
+	if (len >= loop_size || loop_used + size > loop_size) {
+		if (debug_serial)
+			debug_serial->printf("\nLoop buffer full\n");
+		return;
+	}
+
+	ev.time = clock - loop_start;
+	ev.len = len;
+	ev.reserved = 0;
+	if (looper == OSCLoopOverdub) {
+		// Insert at the replay position; the messages before it are due by now
+		if (ev.time >= loop_len)
+			ev.time = loop_len - 1;
+		at = loop_cursor;
+		loop_cursor += size;
+	}
+	else
+		at = loop_used;
+
+	memmove(loop_buffer + at + size, loop_buffer + at, loop_used - at);
+	memcpy(loop_buffer + at, &ev, sizeof(ev));
+	memcpy(loop_buffer + at + sizeof(ev), bytes, len);
+	memset(loop_buffer + at + sizeof(ev) + len, 0, pad_len(len));
+	loop_used += size;
+}
+
+bool OSCManager::replay() {
+	struct LoopEvent ev;
+	bool dispatched = false;
+	uint32_t pos = clock - loop_start;
+
+	while (true) {
+		// Dispatch the next message if it's due
+		if (loop_cursor < loop_used) {
+			memcpy(&ev, loop_buffer + loop_cursor, sizeof(ev));
+			if (ev.time <= pos) {
+				replaying = true;
+				handle_buffer(loop_buffer + loop_cursor + sizeof(ev), ev.len);
+				replaying = false;
+				loop_cursor += sizeof(ev) + ev.len + pad_len(ev.len);
+				dispatched = true;
+				continue;
+			}
+		}
+		if (pos < loop_len)
+			break;
+		// Start the current pass, skipping any that loop() missed entirely
+		uint32_t passes = pos / loop_len;
+		loop_start += passes * loop_len;
+		pos -= passes * loop_len;
+		loop_cursor = 0;
+	}
+	return dispatched;
+}
+
+// Sequence Numbers:
+// ============================================================================
+bool OSCManager::accept_sequence(uint32_t n) {
+	uint32_t addr = remote_addr();
+	uint16_t port = remote_port();
+	uint32_t now = millis();
+	OSCSender *s = NULL;
+	OSCSender *lru = &senders[0];
+	int k;
+
+	n_checks++;
+	for (k = 0; k < OSC_DEDUP_SENDERS; k++) {
+		if (senders[k].window && senders[k].addr == addr && senders[k].port == port) {
+			s = &senders[k];
+			break;
+		}
+		if (!senders[k].window || senders[k].used < lru->used)
+			lru = &senders[k];
+	}
+	// New sender: take a free or the least recently used entry
+	bool fresh = !s;
+	if (fresh) {
+		s = lru;
+		s->addr = addr;
+		s->port = port;
+	}
+	// New sender, or silent long enough to have restarted: seed with n
+	if (fresh || now - s->heard >= OSC_DEDUP_IDLE_MS) {
+		s->last = n;
+		s->window = 1;
+		s->used = n_checks;
+		s->heard = now;
+		return true;
+	}
+	s->used = n_checks;
+	s->heard = now;
+
+	// Newer than the highest seen: slide the window
+	int32_t d = (int32_t)(n - s->last);
+	if (d > 0) {
+		s->window = d < OSC_DEDUP_WINDOW ? (s->window << d) | 1 : 1;
+		s->last = n;
+		return true;
+	}
+
+	// Older: accept once if in the window; further behind is a new epoch
+	// (the sender restarted its count)
+	d = -d;
+	if (d >= OSC_DEDUP_WINDOW) {
+		s->last = n;
+		s->window = 1;
+		return true;
+	}
+	if (s->window >> d & 1)
+		return false;
+	s->window |= (uint32_t)1 << d;
+	return true;
+}
+
+// Clock Sync:
+// ============================================================================
+void OSCManager::set_sync_beacon(IPAddress addr, uint16_t port, uint8_t n) {
+	beacon_address = addr;
+	beacon_port = port;
+	beacon_ports = n > 0 ? n : 1;
+}
+
+void OSCManager::send_beacon() {
+	uint16_t port = beacon_port ? beacon_port : local_port;
+	beacon_time = millis();
+	OSCMessage beacon("/sync/beacon");
+	beacon.add((int32_t)clock_sync->now());
+	for (uint8_t i = 0; i < beacon_ports; i++)
+		send(beacon, beacon_address, port + i);
+}
+
+bool OSCManager::handle_sync(OSCMessage &msg) {
+	// Without a ClockSync, /sync/... messages go to the dispatch table
+	if (!clock_sync)
+		return false;
+	bool master = clock_sync->master();
+
+	// Node: time an exchange with the master on each beacon
+	if (msg.fullMatch("/sync/beacon")) {
+		if (!master) {
+			OSCMessage req("/sync/req");
+			req.add((int32_t)clock_sync->local_time());
+			send(req, remote_addr(), remote_port());
+		}
+	}
+	// Master: answer with the receive and reply times
+	else if (msg.fullMatch("/sync/req")) {
+		if (master && msg.isInt(0)) {
+			uint32_t t2 = clock_sync->now();
+			OSCMessage resp("/sync/resp");
+			resp.add(msg.getInt(0));
+			resp.add((int32_t)t2);
+			resp.add((int32_t)clock_sync->now());
+			send(resp, remote_addr(), remote_port());
+		}
+	}
+	// Node: estimate the offset
+	else if (msg.fullMatch("/sync/resp")) {
+		if (!master && msg.isInt(0) && msg.isInt(1) && msg.isInt(2))
+			clock_sync->exchange(msg.getInt(0), msg.getInt(1), msg.getInt(2));
+	}
+	else return false;
+	return true;
+}
+
+// Bundles and Playout:
+// ============================================================================
+void OSCManager::set_playout(bool enable, uint32_t sample_rate) {
+	playout = enable;
+	playout_rate = sample_rate;
+	playout_synced = false;
+}
+
+void OSCManager::set_playout_buffer(uint8_t *buffer, uint16_t len) {
+	playout_used = 0;
+	playout_buffer = buffer;
+	playout_size = buffer ? len : 0;
+}
+
+uint32_t OSCManager::playout_delay() {
+	if (playout_fixed)
+		return playout_fixed;
+	uint32_t max = playout_rate * OSC_PLAYOUT_MAX_MS / 1000;
+	return (uint32_t)(peak_q4 >> 4) < max ? peak_q4 >> 4 : max;
+}
+
+bool OSCManager::handle_bundle(uint8_t *bytes, size_t len) {
+	uint64_t timetag = 0;
+	uint32_t size, due = 0;
+	size_t i;
+	bool success = true;
+
+	// "#bundle", time tag (NTP format), then elements of a size and contents
+	if (len < 16) {
+		stats.errors++;
+		return false;
+	}
+	for (i = 8; i < 16; i++)
+		timetag = (timetag << 8) | bytes[i];
+
+	// An optional /seq <int> first element numbers the bundle; drop repeats
+	i = 16;
+	if (len >= 25 && memcmp(bytes + 20, "/seq", 5) == 0) {
+		size = (uint32_t)bytes[16] << 24 | (uint32_t)bytes[17] << 16 | 
+			(uint32_t)bytes[18] << 8 | bytes[19];
+		OSCMessage seq;
+		if (size <= len - 20)
+			seq.fill(bytes + 20, size);
+		if (size > len - 20 || seq.hasError() || !seq.isInt(0)) {
+			stats.errors++;
+			return false;
+		}
+		if (!accept_sequence(seq.getInt(0))) {
+			stats.duplicates++;
+			return true;
+		}
+		i = 20 + size;
+	}
+
+	// Time tag 1 means "now"
+	bool delayed = playout && playout_buffer && timetag != 1;
+	if (delayed)
+		due = playout_time(timetag);
+
+	for (; i + 4 <= len; i += size) {
+		size = (uint32_t)bytes[i] << 24 | (uint32_t)bytes[i + 1] << 16 | 
+			(uint32_t)bytes[i + 2] << 8 | bytes[i + 3];
+		i += 4;
+		if (size > len - i) {
+			stats.errors++;
+			return false;
+		}
+		if (delayed && bytes[i] != '#')
+			schedule_message(bytes + i, size, due);
+		else
+			success = handle_buffer(bytes + i, size) && success;
+	}
+	return success;
+}
+
+uint32_t OSCManager::playout_time(uint64_t timetag) {
+	uint32_t now = arrival_set ? arrival : clock;
+
+	// Sender time in samples; wraps like the clock
+	uint32_t sent = (uint32_t)((timetag >> 32) * playout_rate) +
+		(uint32_t)(((timetag & 0xFFFFFFFF) * playout_rate) >> 32);
+
+	// Delay relative to the first bundle's; start over if the sender's clock
+	// jumped (e.g. it restarted)
+	int32_t limit = OSC_PLAYOUT_RESET_S * playout_rate;
+	int32_t d = (int32_t)(now - sent - playout_base);
+	if (!playout_synced || d > limit || d < -limit) {
+		playout_base = now - sent;
+		delay_q4 = 0;
+		jitter_q4 = 0;
+		peak_q4 = 0;
+		playout_synced = true;
+		d = 0;
+	}
+
+	// The delay floor follows new minimums at once and rises slowly (clock
+	// drift). Jitter is the mean excess delay above it; the adaptive playout
+	// delay follows the peak excess and decays slowly, so it stays put while
+	// the network behaves and covers the worst recent delays.
+	int32_t d_q4 = d << 4;
+	if (d_q4 < delay_q4) {
+		peak_q4 += delay_q4 - d_q4;
+		delay_q4 = d_q4;
+	}
+	else
+		delay_q4 += (d_q4 - delay_q4) >> OSC_PLAYOUT_FLOOR_SHIFT;
+	int32_t excess = d_q4 - delay_q4;
+	jitter_q4 += (excess - jitter_q4) >> OSC_PLAYOUT_SHIFT;
+	if (excess > peak_q4)
+		peak_q4 = excess;
+	else
+		peak_q4 -= peak_q4 >> OSC_PLAYOUT_DECAY_SHIFT;
+
+	return sent + playout_base + (delay_q4 >> 4) + playout_delay();
+}
+
+void OSCManager::schedule_message(uint8_t *bytes, size_t len, uint32_t due) {
+	struct LoopEvent ev;
+	uint16_t at;
+	size_t size;
+
+	// Already late: dispatch now
+	if ((int32_t)(due - clock) <= 0) {
+		stats.late++;
+		handle_buffer(bytes, len);
+		return;
+	}
+
+	size = sizeof(ev) + len + pad_len(len);
+	if (len >= playout_size || playout_used + size > playout_size) {
+		stats.overflows++;
+		return;
+	}
+
+	// Insert after the messages due at or before this one
+	for (at = 0; at < playout_used; at += sizeof(ev) + ev.len + pad_len(ev.len)) {
+		memcpy(&ev, playout_buffer + at, sizeof(ev));
+		if ((int32_t)(ev.time - due) > 0)
+			break;
+	}
+
+	ev.time = due;
+	ev.len = len;
+	ev.reserved = 0;
+	memmove(playout_buffer + at + size, playout_buffer + at, playout_used - at);
+	memcpy(playout_buffer + at, &ev, sizeof(ev));
+	memcpy(playout_buffer + at + sizeof(ev), bytes, len);
+	memset(playout_buffer + at + sizeof(ev) + len, 0, pad_len(len));
+	playout_used += size;
+}
+
+bool OSCManager::play_out() {
+	struct LoopEvent ev;
+	uint16_t size;
+	bool dispatched = false;
+
+	while (playout_used) {
+		memcpy(&ev, playout_buffer, sizeof(ev));
+		if ((int32_t)(clock - ev.time) < 0)
+			break;
+		handle_buffer(playout_buffer + sizeof(ev), ev.len);
+		size = sizeof(ev) + ev.len + pad_len(ev.len);
+		playout_used -= size;
+		memmove(playout_buffer, playout_buffer + size, playout_used);
+		dispatched = true;
+	}
+	return dispatched;
 }
 
 // Print utilities:
@@ -119,9 +705,3 @@ void OSCManager::print_osc_msg(char *description, OSCMessage &msg) {
 		debug_serial->printf("\n%24s: %s\n", description, oscpath);
 	}
 }
-
-
-
-
-
-
@@ -8,6 +8,8 @@
 #include <OSCMessage.h>
 #include <stdarg.h>
 #include "Arduino.h"
+#include "ClockSync.h"
+#include "UDPQueue.h"
 
 #ifndef OSC_MAX_NUM_HANDLERS
 #define OSC_MAX_NUM_HANDLERS 32
@@ -15,7 +17,125 @@
 #ifndef OSC_MAX_PATH_LENGTH
 #define OSC_MAX_PATH_LENGTH 64
 #endif
+#ifndef OSC_LOOP_BUFFER_LEN
+#define OSC_LOOP_BUFFER_LEN 4096    // Suggested set_loop_buffer() size
+#endif
+#ifndef OSC_PLAYOUT_BUFFER_LEN
+#define OSC_PLAYOUT_BUFFER_LEN 1024  // Suggested set_playout_buffer() size
+#endif
+#ifndef OSC_LOOP_BUDGET_US
+#define OSC_LOOP_BUDGET_US 2000     // Time loop() may spend reading packets
+#endif
+#ifndef OSC_MAX_FAST_HANDLERS
+#define OSC_MAX_FAST_HANDLERS 4
+#endif
+#ifndef OSC_DEDUP_SENDERS
+#define OSC_DEDUP_SENDERS 8
+#endif
+
+// De-duplication defaults
+#define OSC_DEDUP_WINDOW 32         // Numbers tracked behind the highest seen
+#define OSC_DEDUP_IDLE_MS 5000      // Senders silent this long are seeded afresh
+
+// Playout estimator defaults
+#define OSC_PLAYOUT_SHIFT 4         // Jitter averaging: 1/16 of each new event
+#define OSC_PLAYOUT_FLOOR_SHIFT 12  // Delay floor rise: 1/4096 of each excess
+#define OSC_PLAYOUT_DECAY_SHIFT 10  // Adaptive delay decay: 1/1024 per event
+#define OSC_PLAYOUT_MAX_MS 100      // Longest adaptive delay
+#define OSC_PLAYOUT_RESET_S 2       // Delay changes over 2s are a new sender clock
+
+// Clock sync defaults
+#ifndef OSC_SYNC_BEACON_MS
+#define OSC_SYNC_BEACON_MS 1000     // Master beacon interval
+#endif
+
+// Looper states
+enum {
+    OSCLoopIdle = 0,
+    OSCLoopRecord,      // Recording a new loop
+    OSCLoopPlay,        // Replaying the loop
+    OSCLoopOverdub      // Replaying and adding incoming messages
+};
+
+// Receive counters, accumulated since the last reset_stats()
+struct OSCStats {
+    uint32_t packets;       // UDP packets received
+    uint32_t handled;       // Messages passed to a handler
+    uint32_t unmatched;     // Messages with no matching handler
+    uint32_t errors;        // Malformed messages
+    uint32_t cycles;        // CPU cycles spent parsing and dispatching packets
+    uint32_t late;          // Timestamped messages dispatched after their playout time
+    uint32_t overflows;     // Timestamped messages dropped with the playout buffer full
+    uint32_t duplicates;    // Sequence-numbered bundles dropped as repeats
+    uint32_t fast;          // Messages handled in the UDPQueue receive callback
+    uint32_t send_errors;   // Messages not sent through the UDPQueue (no memory or lwIP error)
+};
+
+// Sequence numbers seen from one sender (IP address and port)
+struct OSCSender {
+    uint32_t addr;
+    uint16_t port;
+    uint32_t last;          // Highest number seen
+    uint32_t window;        // Bit i: last - i seen; 0 if the entry is free
+    uint32_t used;          // Check count at the last use, for replacement
+    uint32_t heard;         // millis() at the last use
+};
 
+// The looper records incoming messages for handlers dispatched as loopable,
+// with their sample-clock time (see tick()), and replays them in a loop through
+// the same handlers. It is off until the sketch provides a buffer with
+// set_loop_buffer(); then it is controlled by these messages, which are handled
+// before any dispatch() handler:
+//
+//  /loop/record    Start recording a new loop
+//  /loop/play      Close the loop being recorded, or leave overdub, and replay
+//  /loop/overdub   Replay and record on top of the loop
+//  /loop/stop      Stop recording or replaying
+//  /loop/clear     Stop and erase the loop
+//
+// Messages are stored as received (OSC bytes, padded to 4) after a time stamp,
+// in time order, in the sketch's buffer. Replayed messages are dispatched on
+// the first loop() at or after their sample, so replay has the timing jitter of
+// loop(), not of the network; passes that loop() misses entirely are skipped.
+//
+// Bundles are unpacked and their messages dispatched as they arrive, unless
+// playout is enabled (with a buffer from set_playout_buffer()): then messages
+// in bundles with a time tag are held back and dispatched at the tag's time
+// plus the network delay floor plus a playout delay, so sender timing survives
+// WiFi jitter. The playout delay is fixed, or follows the recent peak delay
+// above the floor (adaptive). Delays are measured from each packet's arrival:
+// the time the UDPQueue callback received it if one is attached, otherwise
+// the time loop() read it, which adds main-loop latency to the estimate.
+//
+// A bundle whose first element is /seq <int> is numbered per sender: senders
+// can send critical events (e.g. /gate 0) several times a few ms apart, and
+// only the first copy of each number is handled. The last OSC_DEDUP_WINDOW
+// numbers of up to OSC_DEDUP_SENDERS senders are remembered; the least
+// recently used sender is forgotten to make room. The first number from a
+// sender seeds its window, as does the next one after OSC_DEDUP_IDLE_MS of
+// silence; a number OSC_DEDUP_WINDOW or more behind the highest seen starts
+// a new epoch (the sender restarted), so it is accepted and reseeds too.
+//
+// With a ClockSync attached, a master broadcasts a beacon every
+// OSC_SYNC_BEACON_MS, and other nodes time an exchange with it on each one:
+//
+//  /sync/beacon <t>            master --> beacon address (broadcast)
+//  /sync/req <t1>              node --> beacon sender
+//  /sync/resp <t1> <t2> <t3>   master --> request sender
+//
+// All times are sample clock values (ClockSync::now() on the master, local
+// ticks on the node); the node passes each response to ClockSync::exchange().
+// Sync messages are handled before the looper and dispatch() handlers.
+//
+// With a UDPQueue attached, packets are received through its lwIP callback
+// instead of polling WiFiUDP, and messages are sent from the same port.
+// Messages whose path was given to dispatch_fast() are handled in the callback
+// as they arrive, unless earlier packets are still queued (so they never
+// overtake them); they skip playout and sequence numbers, so use it for plain
+// messages that need the lowest latency (e.g. /gate). The looper records them
+// if they are loopable; on Linux that happens on the UDPQueue's thread, so
+// don't record fast messages there while loop() runs. Everything else is
+// queued for loop().
 class OSCManager {
 
 public:
@@ -31,26 +151,111 @@ public:
     // Set a default destination for outgoing messages
     void set_dest(IPAddress addr, uint16_t port);
     
-    // Set OSC handlers for the specified path
-    void dispatch(char *path, void (*handler)(OSCMessage &));
+    // Set OSC handlers for the specified path; the looper records and replays
+    // only messages of loopable handlers (e.g. gates and parameters, not /ping)
+    void dispatch(char *path, void (*handler)(OSCMessage &), bool loopable = false);
+
+    // Receive through a UDPQueue (call before open_port()). Packets longer
+    // than UDPQ_PACKET_LEN (256 bytes by default, e.g. a /sequence of more
+    // than about 50 steps) are dropped; define it larger before including
+    // UDPQueue.h to accept them. Messages of any length are sent, longer
+    // ones from a heap buffer; failed sends are counted in send_errors
+    void set_queue(UDPQueue *udp_queue);
+
+    // Set OSC handlers called in the UDPQueue's receive callback; loopable
+    // ones are recorded by the looper like dispatch() handlers
+    void dispatch_fast(char *path, void (*handler)(OSCMessage &), bool loopable = false);
 
     // OSC Message senders
     void send(OSCMessage &msg);                     // OSC --> default dest
     void send(OSCMessage &msg, IPAddress dest);     // OSC --> specified dest
+    void send(OSCMessage &msg, IPAddress dest, uint16_t port);
+
+    // Loop; reads packets until the budget (microseconds) is spent, at least
+    // one. Returns true if a message was handled.
+    bool loop()                 { return loop(OSC_LOOP_BUDGET_US); }
+    bool loop(uint32_t budget_us);
+
+    // Advance the sample clock of the looper and playout; call once per sample
+    // from the render callback. Replayed and delayed messages are dispatched
+    // from loop() on the first call at or after their sample.
+    void tick()                 { clock++; }
+
+    // Enable the looper with a buffer of len bytes (e.g. OSC_LOOP_BUFFER_LEN)
+    void set_loop_buffer(uint8_t *buffer, uint16_t len);
 
-    // Loop 
-    bool loop(); 
+    // Looper controls (same as the /loop messages)
+    void loop_record();
+    void loop_play();
+    void loop_overdub();
+    void loop_stop();
+    void loop_clear();
+    uint8_t loop_state()        { return looper; }
+    uint32_t loop_length()      { return loop_len; }
+
+    // Enable playout of time-tagged bundles at the render callback's sample
+    // rate; needs a buffer of len bytes (e.g. OSC_PLAYOUT_BUFFER_LEN)
+    void set_playout(bool enable, uint32_t sample_rate);
+    void set_playout_buffer(uint8_t *buffer, uint16_t len);
+
+    // Fixed playout delay in samples; 0 (default) adapts it to the jitter
+    void set_playout_delay(uint32_t samples)    { playout_fixed = samples; }
+
+    // Current jitter estimate and playout delay (samples)
+    uint32_t jitter()           { return jitter_q4 >> 4; }
+    uint32_t playout_delay();
+
+    // Follow a master's clock, or act as the master if sync->master(); the
+    // ClockSync's tick() must be called from the render callback. Until one is
+    // set, /sync/beacon, /sync/req and /sync/resp are dispatched like any
+    // other message
+    void set_clock_sync(ClockSync *sync)        { clock_sync = sync; }
+
+    // Where a master sends beacons (default: broadcast on the local port). n
+    // consecutive ports are sent to, for virtual nodes on the same device.
+    void set_sync_beacon(IPAddress addr, uint16_t port, uint8_t n = 1);
 
     // OSC
     bool handle_message(OSCMessage &msg);
     bool handle_buffer(uint8_t *bytes, size_t len);
 
     // Established via UDP only (should be a /ping)
-    IPAddress remote_addr() { return udp_local.remoteIP(); }
-    uint16_t remote_port() { return udp_local.remotePort(); }
+    IPAddress remote_addr() { return queue ? IPAddress(queue_addr) : udp_local.remoteIP(); }
+    uint16_t remote_port() { return queue ? queue_port : udp_local.remotePort(); }
+
+    // Receive counters
+    const OSCStats &get_stats() { return stats; }
+    void reset_stats()          { memset(&stats, 0, sizeof(stats)); }
 
 protected:
 
+    // Handle one received packet that arrived at the given clock
+    bool receive(uint8_t *data, size_t len, uint32_t arrived);
+
+    // UDPQueue fast path
+    static bool receive_fast(UDPPacket &packet, void *userdata);
+
+    // Dispatch, and report whether the handler is loopable
+    bool handle_message(OSCMessage &msg, bool *loopable);
+
+    // Looper
+    bool handle_loop_control(OSCMessage &msg);
+    void record_message(uint8_t *bytes, size_t len);
+    bool replay();
+
+    // Sequence numbers
+    bool accept_sequence(uint32_t n);
+
+    // Clock sync
+    bool handle_sync(OSCMessage &msg);
+    void send_beacon();
+
+    // Bundles and playout
+    bool handle_bundle(uint8_t *bytes, size_t len);
+    void schedule_message(uint8_t *bytes, size_t len, uint32_t due);
+    bool play_out();
+    uint32_t playout_time(uint64_t timetag);
+
     // Print utilities
     void print_udp(char *description, const char *addr, uint16_t port);
     void print_osc_msg(char *description, OSCMessage &msg);
@@ -58,6 +263,9 @@ protected:
     Stream *debug_serial;
 
     WiFiUDP udp_local;
+    UDPQueue *queue;
+    uint32_t queue_addr;            // Sender of the packet being handled
+    uint16_t queue_port;
 
     uint16_t local_port;
     uint16_t dest_port;
@@ -66,6 +274,51 @@ protected:
     int num_handlers;
     char paths[OSC_MAX_NUM_HANDLERS][OSC_MAX_PATH_LENGTH];
     void (*handlers[OSC_MAX_NUM_HANDLERS])(OSCMessage &);
+    bool loopable[OSC_MAX_NUM_HANDLERS];
+
+    int num_fast_handlers;
+    char fast_paths[OSC_MAX_FAST_HANDLERS][OSC_MAX_PATH_LENGTH];
+    void (*fast_handlers[OSC_MAX_FAST_HANDLERS])(OSCMessage &);
+    bool fast_loopable[OSC_MAX_FAST_HANDLERS];
+
+    OSCStats stats;
+
+    // Looper
+    volatile uint32_t clock;        // Samples counted by tick()
+    uint8_t looper;                 // Looper state
+    bool replaying;                 // Dispatching a recorded message
+    uint32_t loop_start;            // Clock at the start of the current pass
+    uint32_t loop_len;              // Loop length (samples); 0 if none
+    uint16_t loop_used;             // Bytes of loop_buffer in use
+    uint16_t loop_cursor;           // Offset of the next message to replay
+    uint8_t *loop_buffer;           // Set by the sketch; NULL disables the looper
+    uint16_t loop_size;
+
+    // Playout
+    bool playout;                   // Whether time-tagged bundles are delayed
+    uint32_t playout_rate;          // Sample rate of the clock
+    uint32_t playout_fixed;         // Fixed playout delay (samples); 0 if adaptive
+    bool playout_synced;            // Whether the delay estimate has a reference
+    uint32_t playout_base;          // Clock minus sender time of the first bundle
+    int32_t delay_q4;               // Delay floor relative to the base (Q4)
+    int32_t jitter_q4;              // Mean delay above the floor (Q4)
+    int32_t peak_q4;                // Peak delay above the floor, decaying (Q4)
+    uint16_t playout_used;          // Bytes of playout_buffer in use
+    uint8_t *playout_buffer;        // Set by the sketch; NULL disables playout
+    uint16_t playout_size;
+    uint32_t arrival;               // Clock at the arrival of the packet being handled
+    bool arrival_set;               // - if it came through receive()
+
+    // Sequence numbers
+    OSCSender senders[OSC_DEDUP_SENDERS];
+    uint32_t n_checks;
+
+    // Clock sync
+    ClockSync *clock_sync;
+    IPAddress beacon_address;       // Beacon destination; broadcast if not set
+    uint16_t beacon_port;           // First beacon port; local port if 0
+    uint8_t beacon_ports;           // Number of consecutive beacon ports
+    uint32_t beacon_time;           // millis() at the last beacon
 };
 
 #endif
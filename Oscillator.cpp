@@ -4,10 +4,10 @@
 #define LFO8_DFLT_DUTY 0.5
 
 LFO8::LFO8() :
-period(LFO8_DFLT_PERIOD), duty(LFO8_DFLT_DUTY), state(LFOStateIncline), value(0), 
-slope(0), slope_incline(0), slope_decline(0),
-phase(0), len(2), len_incline(1), len_decline(1) {
-	
+period(LFO8_DFLT_PERIOD), duty(LFO8_DFLT_DUTY), duty_frac(LFO8_DFLT_DUTY * 65536), 
+depth(LFO8_LEV_MAX), 
+state(LFOStateIncline), len_incline(1), len_decline(1) {
+	ramp.len = 2;
 }
 
 LFO8::~LFO8() {
@@ -22,61 +22,105 @@ void LFO8::set_period(uint32_t period_samples) {
 void LFO8::set_duty_cycle(float duty_norm) {
 	duty = duty_norm > 0 ? duty_norm : 0;
 	duty = duty < 1 ? duty : 1;
+	duty_frac = duty * 65536;
+	recompute();
+}
+
+void LFO8::set_depth(uint16_t level) {
+	depth = level < LFO8_LEV_MAX ? level : LFO8_LEV_MAX;
 	recompute();
 }
 
+void LFO8::set_phase(uint32_t t) {
+	uint32_t p = len_incline + len_decline;
+	if (p == 0)
+		return;
+	ramp.value = 0;
+	begin_incline();
+	advance(t % p);
+	ramp.jump();
+}
+
+void LFO8::save(Preset &p) {
+	p.put(period);
+	p.put(duty);
+	p.put((uint16_t)depth.getInteger());
+	p.put(ramp.control_period());
+}
+
+bool LFO8::load(Preset &p) {
+	int32_t per;
+	float dut;
+	uint16_t dep, ctl;
+	if (!(p.get(per) && p.get(dut) && p.get(dep) && p.get(ctl)))
+		return false;
+	period = per < LFO8_LEN_MAX ? per : LFO8_LEN_MAX;
+	duty = dut > 0 ? dut : 0;
+	duty = duty < 1 ? duty : 1;
+	duty_frac = duty * 65536;
+	depth = dep < LFO8_LEV_MAX ? dep : LFO8_LEV_MAX;
+	recompute();
+	set_control_period(ctl);
+	return true;
+}
+
 void LFO8::recompute() {
 	
-	SQ9x22 dest;
+	GenFixed dest;
+	int32_t len;
 
-	len_incline = period * duty;
-	len_decline = period * (1.0 - duty);
+	// Integer only: modulation calls this from the render callback
+	len_incline = ((uint64_t)period * duty_frac) >> 16;
+	len_decline = period - len_incline;
 
 	if (state == LFOStateIncline) {
-		len = len_incline - phase;
-		dest = 255;
+		len = len_incline - ramp.phase;
+		dest = depth;
 	}
 	else { 
-		len = len_decline - phase;
+		len = len_decline - ramp.phase;
 		dest = 0;
 	}
 
 	if (len < MIN_RECOMP_LEN) 
 		len = MIN_RECOMP_LEN;
 
-	compute_slope(value, dest, len);	
+	ramp.len = len;
+	ramp.compute_slope(dest, len);
 }
 
-void LFO8::compute_slope(SQ9x22 x0, SQ9x22 x1, int32_t new_len) {
-	len = new_len;
-	slope = x1 - x0;
-	slope = static_cast<float>(slope) / (float)len;
+// Advance n samples, crossing into the next segment(s) if needed
+void LFO8::advance(int32_t n) {
+	int32_t k;
+	while (n > 0) {
+		if (ramp.phase >= ramp.len) {
+			if (state == LFOStateIncline) 
+				begin_decline();
+			else 
+				begin_incline();
+		}
+		k = ramp.remaining(n);
+		ramp.move(k);
+		ramp.phase += k;
+		n -= k;
+	}
 }
 
-uint16_t LFO8::render() {
-	if (phase >= len) {
-		if (state == LFOStateIncline) 
-			begin_decline();
-		else 
-			begin_incline();
+void LFO8::tick() {
+	int32_t n = ramp.control_samples();
+	if (n) {
+		advance(n);
+		ramp.interpolate(ramp.value);
 	}
-	value += slope;
-	int_value = (int16_t)value.getInteger();
-	int_value = int_value > LFO8_LEV_MIN ? int_value : LFO8_LEV_MIN;
-	int_value = int_value < LFO8_LEV_MAX ? int_value : LFO8_LEV_MAX;
-	phase++;
-	return int_value;
+	ramp.next();
 }
 
 void LFO8::begin_incline() {
-	phase = 0;
 	state = LFOStateIncline;
-	compute_slope(value, SQ9x22(255), len_incline);
+	ramp.begin(depth, len_incline);
 }
 
 void LFO8::begin_decline() {
-	phase = 0;
 	state = LFOStateDecline;
-	compute_slope(value, SQ9x22(0), len_decline);
-}
-
+	ramp.begin(GenFixed(0), len_decline);
+}
\ No newline at end of file
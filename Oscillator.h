@@ -4,14 +4,13 @@
 #ifndef OSCILLATOR_H
 #define OSCILLATOR_H
 
-#include <FixedPoints.h>
-#include <FixedPointsCommon.h>
+#include "Ramp.h"
+#include "Timebase.h"
+#include "Preset.h"
 
-#define LFO8_LEN_MAX 2147483647
-#define LFO8_LEV_MAX 255
-#define LFO8_LEV_MIN 0
-
-using SQ9x22 = SFixed<9, 22>;
+#define LFO8_LEN_MAX GEN_LEN_MAX
+#define LFO8_LEV_MAX GEN_LEV_MAX
+#define LFO8_LEV_MIN GEN_LEV_MIN
 
 class LFO8 {
 
@@ -30,28 +29,46 @@ public:
 	~LFO8();
 
 	void set_period(uint32_t period_samples);
+	void set_rate(UQ16x16 hz, const Timebase &tb)	{ set_period(tb.hz_to_period(hz)); }
 	void set_duty_cycle(float duty_norm);
-	uint16_t render();
+
+	// Peak level [0-LFO8_LEV_MAX]; the LFO ramps between 0 and depth
+	void set_depth(uint16_t level);
+
+	// Update state every n samples (rounded down to a power of two, up to 256)
+	// and linearly interpolate the samples in between; 1 updates every sample
+	void set_control_period(uint16_t n)	{ ramp.set_control_period(n); }
+
+	// Jump to the position t samples after the start of an incline (e.g. a
+	// synchronized clock's time, so LFOs with the same settings line up)
+	void set_phase(uint32_t t);
+
+	// Append the parameters to a preset / restore them; load() changes
+	// nothing and returns false if the preset is too short
+	void save(Preset &p);
+	bool load(Preset &p);
+
+	// Render the next sample [0-LFO8_LEV_MAX], or the same sample with
+	// GenRamp::FINE_SHIFT fractional bits (for a Dither8 output stage)
+	uint16_t render()			{ tick(); return ramp.level(); }
+	uint16_t render_fine()		{ tick(); return ramp.fine_level(); }
 
 protected:
 
-	void compute_slope(SQ9x22 x0, SQ9x22 x1, int32_t new_len);
 	void recompute();
+	void advance(int32_t n);
+	void tick();
 	void begin_incline();
 	void begin_decline();
 
 	int32_t period;
 	float duty;
+	uint32_t duty_frac;		// Duty cycle as a fraction of 2^16
+	GenFixed depth;
 	uint8_t state;
 
-	int16_t int_value;
-	SQ9x22 value;
-	SQ9x22 slope;
-	SQ9x22 slope_incline;
-	SQ9x22 slope_decline;
-	
-	int32_t phase;
-	int32_t len;
+	GenRamp ramp;			// Value, slope, phase and output of the current state
+
 	int32_t len_incline;
 	int32_t len_decline;
 };
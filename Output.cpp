@@ -0,0 +1,146 @@
+#define USE_US_TIMER	// Necessary for enabling ETSTimer's microsecond accuracy
+
+#include "Output.h"
+
+#ifdef ARDUINO
+extern "C" {
+#include "user_interface.h"
+#include "sigma_delta.h"
+}
+#include <i2s.h>
+#endif
+
+Output::Output() :
+n_underruns(0), render_handler(NULL), render_userdata(NULL) {
+
+}
+
+uint16_t Output::loop() {
+	uint16_t block[OUT_BLOCK_LEN];
+	uint16_t n = 0;
+	if (render_handler) {
+		while (buffer.space() >= OUT_BLOCK_LEN) {
+			render_handler(block, OUT_BLOCK_LEN, render_userdata);
+			buffer.write(block, OUT_BLOCK_LEN);
+			n += OUT_BLOCK_LEN;
+		}
+	}
+	drain();
+	return n;
+}
+
+#ifdef ARDUINO
+
+// Sigma Delta
+// ===========
+bool SigmaDeltaOutput::begin(uint32_t sample_rate) {
+	sigmaDeltaEnable();
+	sigmaDeltaSetup(channel, carrier_hz);
+	sigmaDeltaAttachPin(pin, channel);
+	system_timer_reinit();
+	ets_timer_setfn(&timer, timer_callback, this);
+	ets_timer_arm_new(&timer, 1000000 / sample_rate, true, 0);
+	return true;
+}
+
+void SigmaDeltaOutput::end() {
+	ets_timer_disarm(&timer);
+	sigmaDeltaDetachPin(pin);
+}
+
+void SigmaDeltaOutput::timer_callback(void *arg) {
+	SigmaDeltaOutput *out = (SigmaDeltaOutput *)arg;
+	uint16_t x;
+	if (out->buffer.pop(x)) {
+#if GEN_OUTPUT_BITS > 8
+		out->last = x >> (GEN_OUTPUT_BITS - 8);
+#else
+		out->last = x << (8 - GEN_OUTPUT_BITS);
+#endif
+	}
+	else
+		out->n_underruns++;
+	sigmaDeltaWrite(out->channel, out->last);
+}
+
+// I2S
+// ===
+bool I2SOutput::begin(uint32_t sample_rate) {
+	i2s_begin();
+	i2s_set_rate(sample_rate);
+	return true;
+}
+
+void I2SOutput::end() {
+	i2s_end();
+}
+
+void I2SOutput::drain() {
+	uint16_t x;
+	if (buffer.empty() && i2s_is_empty())
+		n_underruns++;
+	while (!buffer.empty() && !i2s_is_full()) {
+		buffer.pop(x);
+		// Unsigned generator level to signed 16-bit, copied to both channels
+		uint16_t s = (uint16_t)(((uint32_t)x << (16 - GEN_OUTPUT_BITS)) - 0x8000);
+		i2s_write_sample_nb(((uint32_t)s << 16) | s);
+	}
+}
+
+#else
+
+// WAV File
+// ========
+static void write_le(FILE *file, uint32_t x, int n_bytes) {
+	for (int i = 0; i < n_bytes; i++)
+		fputc((x >> (8 * i)) & 0xFF, file);
+}
+
+bool WavFileOutput::begin(uint32_t sample_rate) {
+	file = fopen(path, "wb");
+	if (!file)
+		return false;
+	rate = sample_rate;
+	n_samples = 0;
+	write_header();
+	return true;
+}
+
+void WavFileOutput::end() {
+	if (!file)
+		return;
+	drain();
+	fseek(file, 0, SEEK_SET);	// Rewrite the header with the final sizes
+	write_header();
+	fclose(file);
+	file = NULL;
+}
+
+void WavFileOutput::drain() {
+	uint16_t x;
+	if (!file)
+		return;
+	while (buffer.pop(x)) {
+		// Unsigned generator level to signed 16-bit
+		write_le(file, (uint16_t)(((uint32_t)x << (16 - GEN_OUTPUT_BITS)) - 0x8000), 2);
+		n_samples++;
+	}
+}
+
+void WavFileOutput::write_header() {
+	uint32_t data_bytes = n_samples * 2;
+	fwrite("RIFF", 1, 4, file);
+	write_le(file, 36 + data_bytes, 4);
+	fwrite("WAVEfmt ", 1, 8, file);
+	write_le(file, 16, 4);			// fmt chunk size
+	write_le(file, 1, 2);			// PCM
+	write_le(file, 1, 2);			// Mono
+	write_le(file, rate, 4);		// Sample rate
+	write_le(file, rate * 2, 4);	// Byte rate
+	write_le(file, 2, 2);			// Block align
+	write_le(file, 16, 2);			// Bits per sample
+	fwrite("data", 1, 4, file);
+	write_le(file, data_bytes, 4);
+}
+
+#endif
@@ -0,0 +1,143 @@
+/*
+ *	Output.h
+ */
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#ifdef ARDUINO
+#include "Arduino.h"
+extern "C" {
+#include "ets_sys.h"
+}
+#else
+#include <stdio.h>
+#endif
+
+#include "RingBuffer.h"
+#include "GenLevels.h"
+
+// Allow user redefinition of the output buffer and render block lengths
+#ifndef OUT_BUFFER_LEN
+#define OUT_BUFFER_LEN 512
+#endif
+#ifndef OUT_BLOCK_LEN
+#define OUT_BLOCK_LEN 32
+#endif
+
+// Output backends play samples [0-GEN_LEV_MAX] from a ring buffer that the
+// render handler fills in blocks from loop(), so rendering runs up to
+// OUT_BUFFER_LEN samples ahead of the output and a late loop() does not drop
+// samples. Backends differ only in how the buffer is drained.
+class Output {
+
+public:
+
+	Output();
+	virtual ~Output() {}
+
+	// Start/stop output at the given sample rate
+	virtual bool begin(uint32_t sample_rate) = 0;
+	virtual void end() {}
+
+	// Set the function that renders blocks of n samples
+	void set_render_handler(void (*handler)(uint16_t *, uint16_t, void *), void *userdata) {
+		render_handler = handler;
+		render_userdata = userdata;
+	}
+
+	// Render blocks while the buffer has room, then drain what the backend can
+	// take now; call often from loop(). Returns the number of samples rendered.
+	uint16_t loop();
+
+	// Queue samples directly; returns the number queued
+	uint16_t write(const uint16_t *samples, uint16_t n)	{ return buffer.write(samples, n); }
+	uint16_t space()									{ return buffer.space(); }
+
+	// Number of samples the backend needed while the buffer was empty
+	uint32_t underruns()			{ return n_underruns; }
+
+protected:
+
+	// Move samples from the buffer to the output (for backends that aren't
+	// driven by a timer)
+	virtual void drain() {}
+
+	RingBuffer<uint16_t, OUT_BUFFER_LEN> buffer;
+	volatile uint32_t n_underruns;
+
+	void (*render_handler)(uint16_t *, uint16_t, void *);	// User render callback
+	void *render_userdata;									// - its userdata
+};
+
+#ifdef ARDUINO
+
+// Sigma-delta channel paced by a microsecond ETSTimer; limited to 8 bits, so
+// wider generator output is shifted down
+class SigmaDeltaOutput : public Output {
+
+public:
+
+	SigmaDeltaOutput(uint8_t pin, uint8_t channel = 0, uint32_t carrier_hz = 240000)
+	: pin(pin), channel(channel), carrier_hz(carrier_hz), last(0) {}
+
+	bool begin(uint32_t sample_rate);
+	void end();
+
+protected:
+
+	static void timer_callback(void *arg);
+
+	uint8_t pin;
+	uint8_t channel;
+	uint32_t carrier_hz;
+	uint8_t last;				// Last sample written; repeated on underrun
+	ETSTimer timer;
+};
+
+// ESP8266 I2S peripheral (16-bit stereo, same sample on both channels), fed from
+// the main loop into its DMA buffers; the I2S clock paces playback, so the only
+// real-time requirement is calling loop() before the DMA buffers run dry
+class I2SOutput : public Output {
+
+public:
+
+	I2SOutput() {}
+
+	bool begin(uint32_t sample_rate);
+	void end();
+
+protected:
+
+	void drain();
+};
+
+#else
+
+// 16-bit mono WAV file sink for rendering offline on a host; every sample in the
+// buffer is written on each loop()
+class WavFileOutput : public Output {
+
+public:
+
+	WavFileOutput(const char *path) : path(path), file(NULL), n_samples(0), rate(0) {}
+	~WavFileOutput()				{ end(); }
+
+	bool begin(uint32_t sample_rate);
+	void end();
+
+	uint32_t samples_written()		{ return n_samples; }
+
+protected:
+
+	void drain();
+	void write_header();
+
+	const char *path;
+	FILE *file;
+	uint32_t n_samples;
+	uint32_t rate;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,74 @@
+/*
+ *	ParamMailbox.h
+ */
+#ifndef PARAMMAILBOX_H
+#define PARAMMAILBOX_H
+
+#include "Arduino.h"
+
+#define PMB_DFLT_PERIOD_MS 5
+
+// Latest-value-wins mailbox for up to 32 continuous parameters. OSC handlers
+// post() each value as it arrives, and loop() passes only the newest value of
+// each changed parameter to its setter, at most once per control period.
+// Discrete events (gates, resets) should call flush() first so they are applied
+// after every parameter change received before them.
+template <uint8_t N>
+class ParamMailbox {
+
+	static_assert(N <= 32, "ParamMailbox holds up to 32 parameters (one dirty bit each)");
+
+public:
+
+	ParamMailbox(uint32_t period_ms = PMB_DFLT_PERIOD_MS)
+	: period_ms(period_ms), t0(0), dirty(0) {
+		for (int i = 0; i < N; i++)
+			setters[i] = NULL;
+	}
+
+	// Set the function that applies parameter idx
+	void attach(uint8_t idx, void (*setter)(float, void *), void *userdata) {
+		setters[idx] = setter;
+		userdatas[idx] = userdata;
+	}
+
+	// Store the newest value of parameter idx
+	void post(uint8_t idx, float value) {
+		values[idx] = value;
+		dirty |= (uint32_t)1 << idx;
+	}
+
+	// Apply changed parameters if a control period has passed;
+	// return true if any were applied
+	bool loop() {
+		if (!dirty || (millis() - t0) < period_ms)
+			return false;
+		t0 = millis();
+		flush();
+		return true;
+	}
+
+	// Apply changed parameters now
+	void flush() {
+		uint32_t pending = dirty;
+		dirty = 0;
+		for (int i = 0; pending; i++, pending >>= 1) {
+			if ((pending & 1) && setters[i])
+				setters[i](values[i], userdatas[i]);
+		}
+	}
+
+	void set_period(uint32_t ms)	{ period_ms = ms; }
+
+protected:
+
+	uint32_t period_ms;						// Control period
+	uint32_t t0;							// Time of the last update
+	uint32_t dirty;							// Bitmask of changed parameters
+
+	float values[N];						// Newest value of each parameter
+	void (*setters[N])(float, void *);		// Setter for each parameter
+	void *userdatas[N];						// - its userdata
+};
+
+#endif
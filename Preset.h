@@ -0,0 +1,61 @@
+/*
+ *	Preset.h
+ */
+#ifndef PRESET_H
+#define PRESET_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Allow user redefinition of the preset size (a full 512-step SEQ8 takes ~3KB)
+#ifndef PRESET_MAX_LEN
+#define PRESET_MAX_LEN 4096
+#endif
+
+// Byte buffer holding a serialized scene. Generators append their parameters
+// and patterns with save() and read them back, in the same order, with load().
+// Values are stored in native byte order (little-endian on the ESP8266 and x86).
+class Preset {
+
+public:
+
+	Preset() : len(0), pos(0) {}
+
+	// Empty the buffer / start reading from the beginning
+	void clear()			{ len = 0; pos = 0; }
+	void rewind()			{ pos = 0; }
+
+	// Append or read n bytes; return false if the buffer is full or exhausted
+	bool write(const void *x, uint16_t n) {
+		if (n > PRESET_MAX_LEN - len)
+			return false;
+		memcpy(data + len, x, n);
+		len += n;
+		return true;
+	}
+	bool read(void *x, uint16_t n) {
+		if (n > remaining())
+			return false;
+		memcpy(x, data + pos, n);
+		pos += n;
+		return true;
+	}
+
+	template <typename T>
+	bool put(const T &x)	{ return write(&x, sizeof(T)); }
+	template <typename T>
+	bool get(T &x)			{ return read(&x, sizeof(T)); }
+
+	uint16_t size() const		{ return len; }
+	uint16_t remaining() const	{ return len - pos; }
+
+protected:
+
+	friend class PresetStore;
+
+	uint8_t data[PRESET_MAX_LEN];
+	uint16_t len;		// Bytes written
+	uint16_t pos;		// Read position
+};
+
+#endif
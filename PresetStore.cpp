@@ -0,0 +1,137 @@
+#include "PresetStore.h"
+
+#ifdef ARDUINO
+#include <LittleFS.h>
+#else
+#include <stdio.h>
+#include <errno.h>
+#include <sys/stat.h>
+#endif
+
+#define PRESET_VALIDATION_STRING "prs2"
+#define PRESET_PATH_LEN 64
+
+struct PresetHeader {
+	char valid[8];
+	uint16_t len;
+	uint16_t checksum;
+};
+
+bool PresetStore::slot_path(uint8_t slot, char *path, size_t len) {
+	if (slot >= PRESET_NUM_SLOTS)
+		return false;
+	return snprintf(path, len, "%s/%u.bin", dir, slot) < (int)len;
+}
+
+uint16_t PresetStore::checksum(const uint8_t *data, uint16_t len) {
+	// Fletcher-16
+	uint16_t a = 0, b = 0;
+	for (uint16_t i = 0; i < len; i++) {
+		a = (a + data[i]) % 255;
+		b = (b + a) % 255;
+	}
+	return (b << 8) | a;
+}
+
+#ifdef ARDUINO
+
+bool PresetStore::begin() {
+	return LittleFS.begin();
+}
+
+bool PresetStore::save(uint8_t slot, const Preset &p) {
+	char path[PRESET_PATH_LEN];
+	struct PresetHeader header;
+	if (!slot_path(slot, path, sizeof(path)))
+		return false;
+	File file = LittleFS.open(path, "w");
+	if (!file)
+		return false;
+	memset(&header, 0, sizeof(header));
+	strcpy(header.valid, PRESET_VALIDATION_STRING);
+	header.len = p.len;
+	header.checksum = checksum(p.data, p.len);
+	bool success = file.write((const uint8_t *)&header, sizeof(header)) == sizeof(header)
+		&& file.write(p.data, p.len) == p.len;
+	file.close();
+	return success;
+}
+
+bool PresetStore::load(uint8_t slot, Preset &p) {
+	char path[PRESET_PATH_LEN];
+	struct PresetHeader header;
+	p.clear();
+	if (!slot_path(slot, path, sizeof(path)))
+		return false;
+	File file = LittleFS.open(path, "r");
+	if (!file)
+		return false;
+	bool success = file.read((uint8_t *)&header, sizeof(header)) == sizeof(header)
+		&& strcmp(header.valid, PRESET_VALIDATION_STRING) == 0
+		&& header.len <= PRESET_MAX_LEN
+		&& file.read(p.data, header.len) == header.len
+		&& checksum(p.data, header.len) == header.checksum;
+	file.close();
+	if (success)
+		p.len = header.len;
+	return success;
+}
+
+bool PresetStore::remove(uint8_t slot) {
+	char path[PRESET_PATH_LEN];
+	if (!slot_path(slot, path, sizeof(path)))
+		return false;
+	return LittleFS.remove(path);
+}
+
+#else
+
+bool PresetStore::begin() {
+	return mkdir(dir, 0755) == 0 || errno == EEXIST;
+}
+
+bool PresetStore::save(uint8_t slot, const Preset &p) {
+	char path[PRESET_PATH_LEN];
+	struct PresetHeader header;
+	if (!slot_path(slot, path, sizeof(path)))
+		return false;
+	FILE *file = fopen(path, "wb");
+	if (!file)
+		return false;
+	memset(&header, 0, sizeof(header));
+	strcpy(header.valid, PRESET_VALIDATION_STRING);
+	header.len = p.len;
+	header.checksum = checksum(p.data, p.len);
+	bool success = fwrite(&header, sizeof(header), 1, file) == 1
+		&& fwrite(p.data, 1, p.len, file) == p.len;
+	return fclose(file) == 0 && success;
+}
+
+bool PresetStore::load(uint8_t slot, Preset &p) {
+	char path[PRESET_PATH_LEN];
+	struct PresetHeader header;
+	p.clear();
+	if (!slot_path(slot, path, sizeof(path)))
+		return false;
+	FILE *file = fopen(path, "rb");
+	if (!file)
+		return false;
+	bool success = fread(&header, sizeof(header), 1, file) == 1
+		&& strcmp(header.valid, PRESET_VALIDATION_STRING) == 0
+		&& header.len <= PRESET_MAX_LEN
+		&& fread(p.data, 1, header.len, file) == header.len
+		&& checksum(p.data, header.len) == header.checksum;
+	fclose(file);
+	if (success)
+		p.len = header.len;
+	return success;
+}
+
+bool PresetStore::remove(uint8_t slot) {
+	char path[PRESET_PATH_LEN];
+	if (!slot_path(slot, path, sizeof(path)))
+		return false;
+	return ::remove(path) == 0;
+}
+
+#endif
@@ -0,0 +1,50 @@
+/*
+ *	PresetStore.h
+ */
+#ifndef PRESETSTORE_H
+#define PRESETSTORE_H
+
+#include "Preset.h"
+
+// Allow user redefinition of the number of slots
+#ifndef PRESET_NUM_SLOTS
+#define PRESET_NUM_SLOTS 16
+#endif
+
+// Default directory: at the root of LittleFS, or under the working directory
+// on a host
+#ifdef ARDUINO
+#define PRESET_DFLT_DIR "/presets"
+#else
+#define PRESET_DFLT_DIR "presets"
+#endif
+
+// Numbered preset slots, one file per slot under a directory: on LittleFS
+// (flash) on the ESP8266, or in the local filesystem on a host, so presets
+// written by a sketch can be inspected and tested on Linux. Each file holds a
+// validation string, the preset length and a checksum, then the preset bytes.
+class PresetStore {
+
+public:
+
+	PresetStore(const char *dir = PRESET_DFLT_DIR) : dir(dir) {}
+
+	// Mount the filesystem (ESP8266) or create the directory (host)
+	bool begin();
+
+	// Write/read a slot [0-PRESET_NUM_SLOTS); load() rewinds the preset for
+	// reading and returns false (leaving it empty) if the slot is empty or
+	// corrupt
+	bool save(uint8_t slot, const Preset &p);
+	bool load(uint8_t slot, Preset &p);
+	bool remove(uint8_t slot);
+
+protected:
+
+	bool slot_path(uint8_t slot, char *path, size_t len);
+	static uint16_t checksum(const uint8_t *data, uint16_t len);
+
+	const char *dir;
+};
+
+#endif
@@ -0,0 +1,129 @@
+#include "Quantizer.h"
+
+#define QNT_VALIDATION_STRING "qnt1"
+
+Quantizer::Quantizer(int eeprom_addr, Stream *debug_serial) :
+scale(QNT_SCALE_CHROMATIC), root(0), eeprom_addr(eeprom_addr), debug_serial(debug_serial) {
+	cal.n_points = 0;
+	rebuild();
+}
+
+bool Quantizer::init() {
+
+	bool success = true;
+	EEPROM.get(eeprom_addr, cal);
+
+	if (!(strcmp(cal.valid, QNT_VALIDATION_STRING) == 0) || cal.n_points > QNT_MAX_CAL_POINTS) {
+		cal.n_points = 0;
+		success = false;
+	}
+	else if (debug_serial) {
+		debug_serial->println("Quantizer calibration loaded:");
+		print_calibration();
+	}
+
+	rebuild();
+	return success;
+}
+
+void Quantizer::set_scale(uint16_t mask) {
+	scale = mask & QNT_SCALE_CHROMATIC;
+	rebuild();
+}
+
+void Quantizer::set_root(uint8_t p_root) {
+	root = p_root % 12;
+	rebuild();
+}
+
+bool Quantizer::set_point(uint8_t note, uint16_t level) {
+	int i;
+
+	// Replace an existing point for this note
+	for (i = 0; i < cal.n_points; i++) {
+		if (cal.note[i] == note) {
+			cal.level[i] = level;
+			rebuild();
+			return true;
+		}
+	}
+	if (cal.n_points >= QNT_MAX_CAL_POINTS)
+		return false;
+
+	// Insert, keeping notes in ascending order
+	for (i = cal.n_points; i > 0 && cal.note[i - 1] > note; i--) {
+		cal.note[i] = cal.note[i - 1];
+		cal.level[i] = cal.level[i - 1];
+	}
+	cal.note[i] = note;
+	cal.level[i] = level;
+	cal.n_points++;
+	rebuild();
+	return true;
+}
+
+void Quantizer::clear_points() {
+	cal.n_points = 0;
+	rebuild();
+}
+
+void Quantizer::save_calibration() {
+
+	if (debug_serial) {
+		debug_serial->println("Saving quantizer calibration:");
+		print_calibration();
+	}
+
+	strcpy(cal.valid, QNT_VALIDATION_STRING);
+	EEPROM.put(eeprom_addr, cal);
+	EEPROM.commit();
+}
+
+uint8_t Quantizer::quantize(uint8_t note) {
+	int n;
+	if (!scale)
+		return note;
+	for (int d = 0; d < 12; d++) {
+		n = note - d;
+		if (n >= 0 && (scale >> ((n + 12 - root) % 12) & 1))
+			return n;
+		n = note + d;
+		if (n < QNT_TABLE_LEN && (scale >> ((n + 12 - root) % 12) & 1))
+			return n;
+	}
+	return note;
+}
+
+uint16_t Quantizer::calibrated_level(uint8_t note) {
+	int32_t level;
+	int i;
+
+	if (cal.n_points == 0)
+		level = (int32_t)note * QNT_DFLT_SEMITONE;
+	else if (cal.n_points == 1)
+		level = cal.level[0] + ((int32_t)note - cal.note[0]) * QNT_DFLT_SEMITONE;
+	else {
+		// Segment containing the note, or the first/last segment to extrapolate
+		for (i = 0; i < cal.n_points - 2 && note > cal.note[i + 1]; i++);
+		int32_t dn = cal.note[i + 1] - cal.note[i];
+		int32_t dl = (int32_t)cal.level[i + 1] - cal.level[i];
+		level = cal.level[i] + ((int32_t)note - cal.note[i]) * dl / (dn > 0 ? dn : 1);
+	}
+
+	level = level > 0 ? level : 0;
+	return level < 0xFFFF ? level : 0xFFFF;
+}
+
+void Quantizer::rebuild() {
+	for (int i = 0; i < QNT_TABLE_LEN; i++)
+		table[i] = calibrated_level(quantize(i));
+}
+
+void Quantizer::print_calibration() {
+	for (int i = 0; i < cal.n_points; i++) {
+		debug_serial->print("note ");
+		debug_serial->print(cal.note[i]);
+		debug_serial->print(" = ");
+		debug_serial->println(cal.level[i] / 256.0);
+	}
+}
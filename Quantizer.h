@@ -0,0 +1,86 @@
+/*
+ *	Quantizer.h
+ */
+#ifndef QUANTIZER_H
+#define QUANTIZER_H
+
+#include "Arduino.h"
+#include <EEPROM.h>
+#include "Ramp.h"
+
+// Allow user redefinition of the number of calibration points
+#ifndef QNT_MAX_CAL_POINTS
+#define QNT_MAX_CAL_POINTS 16
+#endif
+
+#define QNT_TABLE_LEN 256
+
+// Output levels (8.8) per semitone for 1V/oct over the 8-bit, 3.3V output
+#define QNT_DFLT_SEMITONE 1651
+
+// Scale masks; bit i allows the note i semitones above the root
+#define QNT_SCALE_CHROMATIC 0x0FFF
+#define QNT_SCALE_MAJOR 0x0AB5
+#define QNT_SCALE_MINOR 0x05AD
+#define QNT_SCALE_PENTATONIC 0x0295
+
+struct QuantizerCalibration {
+	char valid[8];
+	uint8_t n_points;
+	uint8_t note[QNT_MAX_CAL_POINTS];		// Note numbers, ascending
+	uint16_t level[QNT_MAX_CAL_POINTS];		// Measured output levels (8.8)
+};
+
+// Maps generator output, read as note numbers [0-255], to the nearest note in a
+// scale and then to a calibrated output level (8.8, for Dither8). Calibration
+// points are interpolated linearly and stored in EEPROM (flash); the scale and
+// calibration are folded into one table, so process() is one lookup per sample.
+class Quantizer {
+
+public:
+
+	Quantizer(int eeprom_addr, Stream *debug_serial = NULL);
+
+	// Load calibration from EEPROM; call after EEPROM.begin() (wifi.init());
+	// returns false if none was saved
+	bool init();
+
+	// Scale mask (see QNT_SCALE_*; 0 disables quantization) and root [0-11]
+	void set_scale(uint16_t mask);
+	void set_root(uint8_t root);
+
+	// Add or move the calibration point for a note; returns false if full
+	bool set_point(uint8_t note, uint16_t level);
+	void clear_points();
+
+	// Write the calibration points to EEPROM
+	void save_calibration();
+
+	// Quantized, calibrated output level (8.8) of a generator sample
+	uint16_t process(uint16_t x) {
+#if GEN_OUTPUT_BITS > 8
+		x >>= GEN_OUTPUT_BITS - 8;
+#endif
+		return table[x < QNT_TABLE_LEN ? x : QNT_TABLE_LEN - 1];
+	}
+
+	// Nearest note in the scale
+	uint8_t quantize(uint8_t note);
+
+	// Calibrated output level (8.8) of a note
+	uint16_t calibrated_level(uint8_t note);
+
+protected:
+
+	void rebuild();
+	void print_calibration();
+
+	uint16_t table[QNT_TABLE_LEN];		// Output level of each input
+	uint16_t scale;
+	uint8_t root;
+	struct QuantizerCalibration cal;
+	int eeprom_addr;
+	Stream *debug_serial;
+};
+
+#endif
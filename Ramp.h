@@ -0,0 +1,191 @@
+/*
+ *	Ramp.h
+ */
+#ifndef RAMP_H
+#define RAMP_H
+
+#include <FixedPoints.h>
+#include <FixedPointsCommon.h>
+#include "Curve.h"
+#include "GenLevels.h"
+
+using SQ9x22 = SFixed<9, 22>;
+
+// Ramp shared by the generators: the current value, slope and segment
+// phase/length, the constrained output and control-rate interpolation. Bits is
+// the output resolution; the default fixed-point format has one integer bit of
+// headroom above it and the remaining bits of an int32_t as fraction.
+//
+// Segments are linear unless a curve is set (see Curve.h): then move() looks
+// the value up from the segment's progress in a shared curve table instead of
+// adding the slope, at the cost of a few integer multiplies per update.
+template <uint8_t Bits, typename Fixed = SFixed<Bits + 1, 30 - Bits> >
+class Ramp {
+
+	static_assert(Bits > 0 && Bits <= 16, "Ramp output is limited to 16 bits");
+
+public:
+
+	typedef Fixed FixedType;
+
+	static constexpr int32_t LEV_MAX = ((int32_t)1 << Bits) - 1;
+	static constexpr int32_t LEV_MIN = 0;
+	static constexpr uint8_t CTL_SHIFT_MAX = 8;
+
+	// Fractional bits kept below the output resolution by fine_level()
+	static constexpr uint8_t FINE_SHIFT = 16 - Bits;
+
+	Ramp(Fixed x = Fixed(0))
+	: value(x), slope(0), phase(0), len(1), ctl_shift(0), ctl_count(0), out(x), out_inc(0),
+	curve(NULL), curve_inv(false), next_curve(NULL), next_inv(false),
+	x0(x), span(0), c_phase(0), c_inc(0), c_left(0) {}
+
+	// Shape of the segments computed from now on: curvature [-CURVE_MAX,
+	// CURVE_MAX], 0 for linear (see curve_prepare())
+	void set_curve(int8_t c) {
+		next_curve = c ? curve_table(c > 0 ? c : -c) : NULL;
+		next_inv = c < 0;
+	}
+
+	// Compute a slope to reach x1 from the current value in n samples
+	void compute_slope(Fixed x1, int32_t n) {
+		n = n > 0 ? n : 1;
+		slope = x1 - value;
+		curve = next_curve;
+		curve_inv = next_inv;
+		if (curve) {
+			x0 = value;
+			span = slope;
+			c_phase = 0;
+			c_inc = 0xFFFFFFFF / (uint32_t)n;
+			c_left = n;
+		}
+		// Rounded integer divide; setters may run in the render callback, so
+		// no soft-float here
+		int32_t s = slope.getInternal();
+		slope = Fixed::fromInternal((s + (s < 0 ? -(n >> 1) : (n >> 1))) / n);
+	}
+
+	// Begin a segment reaching x1 in n samples
+	void begin(Fixed x1, int32_t n) {
+		phase = 0;
+		len = n;
+		compute_slope(x1, n);
+	}
+
+	// Samples left in the current segment, constrained to [1, n]
+	int32_t remaining(int32_t n) const {
+		int32_t k = len - phase;
+		k = k < n ? k : n;
+		return k > 1 ? k : 1;
+	}
+
+	// Move the value k samples along the slope (or curve)
+	void move(int32_t k) {
+		if (!curve) {
+			value += Fixed::fromInternal(slope.getInternal() * k);
+			return;
+		}
+		if ((uint32_t)k >= c_left) {
+			c_left = 0;
+			value = x0 + span;
+			return;
+		}
+		c_left -= k;
+		c_phase += c_inc * k;
+		int32_t c = curve_inv ? CURVE_ONE - curve_lookup(curve, ~c_phase) : curve_lookup(curve, c_phase);
+		// span * c (Q15) in two 32-bit multiplies
+		int32_t s = span.getInternal();
+		value = x0 + Fixed::fromInternal((s >> 15) * c + (((s & 0x7FFF) * c) >> 15));
+	}
+
+	// Update state every n samples (rounded down to a power of two, up to 256)
+	// and linearly interpolate the samples in between; 1 updates every sample
+	void set_control_period(uint16_t n) {
+		ctl_shift = 0;
+		while ((n >>= 1) && ctl_shift < CTL_SHIFT_MAX)
+			ctl_shift++;
+		ctl_count = 0;
+	}
+	uint16_t control_period() const		{ return 1 << ctl_shift; }
+
+	// Number of samples the generator should advance before the next output
+	// sample: 1 at the audio rate, the control period at the start of each
+	// control period and 0 while interpolating
+	int32_t control_samples() {
+		if (ctl_shift == 0)
+			return 1;
+		if (ctl_count)
+			return 0;
+		ctl_count = 1 << ctl_shift;
+		return ctl_count;
+	}
+
+	// Set the level the output reaches at the end of the control period
+	void interpolate(Fixed x) {
+		if (ctl_shift == 0)
+			out = x;
+		else
+			out_inc = Fixed::fromInternal((x - out).getInternal() >> ctl_shift);
+	}
+
+	// Move the output straight to the value and restart the control period
+	// (after the generator jumps to a new position)
+	void jump() {
+		out = value;
+		ctl_count = 0;
+	}
+
+	// Move the output to the next sample
+	void next() {
+		if (ctl_shift) {
+			ctl_count--;
+			out += out_inc;
+		}
+	}
+
+	// Current output, constrained to [LEV_MIN, LEV_MAX]
+	uint16_t level() const		{ return constrain_level(out); }
+
+	// Current output with FINE_SHIFT fractional bits, constrained to
+	// [LEV_MIN, 65535] (e.g. 8.8 for 8-bit output)
+	uint16_t fine_level() const {
+		int32_t i = out.getInternal() >> (Fixed::FractionSize - FINE_SHIFT);
+		i = i > 0 ? i : 0;
+		return i < 0xFFFF ? i : 0xFFFF;
+	}
+
+	static uint16_t constrain_level(Fixed x) {
+		int32_t i = x.getInteger();
+		i = i > LEV_MIN ? i : LEV_MIN;
+		return i < LEV_MAX ? i : LEV_MAX;
+	}
+
+	Fixed value;			// Current fixed point value
+	Fixed slope;			// Current fixed point slope
+	int32_t phase;			// Current segment's phase
+	int32_t len;			// Current segment's length
+
+protected:
+
+	uint8_t ctl_shift;		// Log2 of the control period
+	uint16_t ctl_count;		// Samples left in the current control period
+	Fixed out;				// Interpolated output value
+	Fixed out_inc;			// Interpolation increment
+
+	// Curved segments
+	const uint16_t *curve;		// Table of the current segment; NULL if linear
+	bool curve_inv;				// Whether it's mirrored (negative curvature)
+	const uint16_t *next_curve;	// - for the next segment
+	bool next_inv;
+	Fixed x0;					// Segment start value
+	Fixed span;					// Segment end minus start value
+	uint32_t c_phase;			// Segment progress (Q32)
+	uint32_t c_inc;				// - per sample
+	uint32_t c_left;			// Samples left
+};
+
+typedef Ramp<GEN_OUTPUT_BITS> GenRamp;
+typedef GenRamp::FixedType GenFixed;
+
+#endif
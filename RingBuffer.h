@@ -0,0 +1,81 @@
+/*
+ *	RingBuffer.h
+ */
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <stdint.h>
+
+// Single-producer, single-consumer ring buffer of N elements (N a power of two).
+// One side may run in the main loop and the other in a timer callback or
+// interrupt: each index is written by only one side, with a release store after
+// the elements it covers, and read by the other with an acquire load.
+template <typename T, uint16_t N>
+class RingBuffer {
+
+	static_assert(N > 1 && (N & (N - 1)) == 0, "RingBuffer length must be a power of two");
+
+public:
+
+	RingBuffer() : head(0), tail(0) {}
+
+	// Number of elements waiting to be read / that can be written
+	uint16_t available() const	{ return (uint16_t)(load(head) - load(tail)); }
+	uint16_t space() const		{ return N - available(); }
+	bool empty() const			{ return load(head) == load(tail); }
+
+	// Producer side
+	bool push(const T &x) {
+		if (space() == 0)
+			return false;
+		buff[head & (N - 1)] = x;
+		store(head, head + 1);
+		return true;
+	}
+
+	// Write up to n elements; returns the number written
+	uint16_t write(const T *x, uint16_t n) {
+		uint16_t s = space();
+		n = n < s ? n : s;
+		for (uint16_t i = 0; i < n; i++)
+			buff[(head + i) & (N - 1)] = x[i];
+		store(head, head + n);
+		return n;
+	}
+
+	// Consumer side
+	bool pop(T &x) {
+		if (empty())
+			return false;
+		x = buff[tail & (N - 1)];
+		store(tail, tail + 1);
+		return true;
+	}
+
+	// Read up to n elements; returns the number read
+	uint16_t read(T *x, uint16_t n) {
+		uint16_t a = available();
+		n = n < a ? n : a;
+		for (uint16_t i = 0; i < n; i++)
+			x[i] = buff[(tail + i) & (N - 1)];
+		store(tail, tail + n);
+		return n;
+	}
+
+	// Element at the front, without removing it (buffer must not be empty)
+	const T &peek() const		{ return buff[tail & (N - 1)]; }
+
+	// Discard everything (consumer side)
+	void clear()				{ store(tail, load(head)); }
+
+protected:
+
+	static uint16_t load(const uint16_t &i)		{ return __atomic_load_n(&i, __ATOMIC_ACQUIRE); }
+	static void store(uint16_t &i, uint16_t x)	{ __atomic_store_n(&i, x, __ATOMIC_RELEASE); }
+
+	T buff[N];
+	uint16_t head;				// Free-running write index
+	uint16_t tail;				// Free-running read index
+};
+
+#endif
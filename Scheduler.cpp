@@ -0,0 +1,78 @@
+#include "Scheduler.h"
+
+Scheduler::Scheduler(uint32_t pass_budget_us) :
+n_tasks(0), resume(0), pass_budget(pass_budget_us) {
+
+}
+
+int Scheduler::add_task(const char *name, bool (*task)(uint32_t, void *), void *userdata, 
+	uint8_t priority, uint32_t budget_us, uint32_t period_ms) {
+	if (n_tasks >= SCHED_MAX_TASKS)
+		return -1;
+
+	// Run after the tasks of the same or higher priority
+	int i = n_tasks;
+	while (i > 0 && tasks[order[i - 1]].priority < priority) {
+		order[i] = order[i - 1];
+		i--;
+	}
+	order[i] = n_tasks;
+
+	sched_task_t &t = tasks[n_tasks];
+	t.name = name;
+	t.fn = task;
+	t.userdata = userdata;
+	t.priority = priority;
+	t.enabled = true;
+	t.budget_us = budget_us;
+	t.period_ms = period_ms;
+	t.last_ms = millis();
+	memset(&t.stats, 0, sizeof(t.stats));
+	return n_tasks++;
+}
+
+void Scheduler::enable(int idx, bool enabled) {
+	if (idx >= 0 && idx < n_tasks)
+		tasks[idx].enabled = enabled;
+}
+
+bool Scheduler::loop() {
+	bool busy = false;
+	uint32_t start = micros();
+	uint8_t first = resume;
+	resume = 0;
+
+	for (uint8_t i = first; i < n_tasks; i++) {
+		sched_task_t &t = tasks[order[i]];
+		if (!t.enabled)
+			continue;
+		if (t.period_ms && millis() - t.last_ms < t.period_ms)
+			continue;
+
+		// Leave the rest for the next pass once the budget is used
+		if (pass_budget && i > first && micros() - start >= pass_budget) {
+			resume = i;
+			break;
+		}
+
+		uint32_t t0 = micros();
+		t.last_ms = millis();
+		bool did = t.fn(t.budget_us, t.userdata);
+		uint32_t dt = micros() - t0;
+		t.stats.runs++;
+		if (did) {
+			t.stats.busy++;
+			busy = true;
+		}
+		if (dt > t.budget_us)
+			t.stats.overruns++;
+		if (dt > t.stats.max_us)
+			t.stats.max_us = dt;
+	}
+	return busy;
+}
+
+void Scheduler::reset_stats() {
+	for (uint8_t i = 0; i < n_tasks; i++)
+		memset(&tasks[i].stats, 0, sizeof(tasks[i].stats));
+}
@@ -0,0 +1,78 @@
+/*
+ *	Scheduler.h
+ */
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "Arduino.h"
+
+// Allow user redefinition of the task table size
+#ifndef SCHED_MAX_TASKS
+#define SCHED_MAX_TASKS 16
+#endif
+
+// Per-task counters
+struct SchedStats {
+	uint32_t runs;			// Calls
+	uint32_t busy;			// Calls that did work
+	uint32_t overruns;		// Calls that took longer than the budget
+	uint32_t max_us;		// Longest call
+};
+
+// Cooperative scheduler for loop(). Subsystems register tasks with a priority,
+// a time budget and an optional minimum period; loop() runs the due tasks from
+// the highest priority down, passing each its budget (e.g. OSCManager drains
+// packets until its budget is spent). Tasks must return on their own, so the
+// budget is a contract rather than preemption; overruns are counted per task.
+// With a pass budget set, tasks left over when a pass has used it run first on
+// the next call, so low-priority tasks are delayed but never starved.
+class Scheduler {
+
+public:
+
+	Scheduler(uint32_t pass_budget_us = 0);
+
+	// Register a task; returns its index (tasks are indexed in the order they
+	// were added, whatever their priority) or -1 if the table is full. The
+	// task returns true if it did work. Tasks run at most every period_ms (0
+	// runs them on every pass). The name is kept, not copied.
+	int add_task(const char *name, bool (*task)(uint32_t, void *), void *userdata, 
+		uint8_t priority, uint32_t budget_us, uint32_t period_ms = 0);
+
+	// Pause/resume a task
+	void enable(int idx, bool enabled);
+
+	// Time allowed for one pass (0: run every due task on every call)
+	void set_pass_budget(uint32_t us)	{ pass_budget = us; }
+
+	// Run one pass; call from loop(). Returns true if any task did work.
+	bool loop();
+
+	// Name and counters of a task
+	uint8_t num_tasks()					{ return n_tasks; }
+	const char *get_name(int idx)		{ return tasks[idx].name; }
+	const SchedStats &get_stats(int idx)	{ return tasks[idx].stats; }
+	void reset_stats();
+
+protected:
+
+	typedef struct sched_task_t {
+		const char *name;
+		bool (*fn)(uint32_t, void *);
+		void *userdata;
+		uint8_t priority;
+		bool enabled;
+		uint32_t budget_us;
+		uint32_t period_ms;
+		uint32_t last_ms;			// millis() at the last run
+		SchedStats stats;
+	} sched_task_t;
+
+	sched_task_t tasks[SCHED_MAX_TASKS];	// In the order added
+	uint8_t order[SCHED_MAX_TASKS];			// Task indices by priority, highest first
+	uint8_t n_tasks;
+	uint8_t resume;							// Position in order to start the next pass at
+	uint32_t pass_budget;
+};
+
+#endif
@@ -1,9 +1,11 @@
 #include "Sequencer.h"
 
 SEQ8::SEQ8() :
-gated(false), value(SQ9x22(SEQ8_DFLT_VALUE)), slope(SQ9x22(0)), int_value(SEQ8_DFLT_VALUE),
+gated(false), ext_clock(false), clocked(false), ramp(GenFixed(SEQ8_DFLT_VALUE)),
 uniform_step(true), steplen(SEQ8_DFLT_LEN),
-n_steps(0), step_idx(0), phase(0), len(SEQ8_DFLT_LEN), glidelen(SEQ8_DFLT_GLIDE) {
+n_steps(0), step_idx(0), glidelen(SEQ8_DFLT_GLIDE), glide_curve(0),
+eos_handler(NULL), eos_userdata(NULL) {
+	ramp.len = SEQ8_DFLT_LEN;
 	for (int i = 0; i < SEQ8_MAX_STEPS; i++) {
 		steps[i] = seq_step_t(SEQ8_DFLT_VALUE, SEQ8_DFLT_LEN);
 	}
@@ -24,46 +26,82 @@ void SEQ8::set_glide_length(uint32_t length) {
 }
 
 
-void SEQ8::append_step(uint8_t value) {
+void SEQ8::append_step(uint16_t value) {
 	append_step(value, steplen);
 }
 
-void SEQ8::append_step(uint8_t value, int32_t length) {
+void SEQ8::append_step(uint16_t value, int32_t length) {
 	steps[n_steps++] = seq_step_t(value, length);
 }
 
-void SEQ8::set_step(uint16_t step_idx, uint8_t value) {
+void SEQ8::set_step(uint16_t step_idx, uint16_t value) {
 	set_step(step_idx, value, steplen);
 }
 
-void SEQ8::set_step(uint16_t idx, uint8_t value, int32_t length) {
+void SEQ8::set_step(uint16_t idx, uint16_t value, int32_t length) {
 	if (idx < 0 || idx >= n_steps)
 		return;
-	steps[idx].value = SQ9x22(value);
+	steps[idx].value = GenFixed(value);
 	steps[idx].length = length;
 	// If we're modifying the current step, recompute the slope
 	if (idx == step_idx) {
-		compute_slope(value, steps[idx].value, glidelen);
-		len = steps[idx].length - phase;
-		len = len > 1 ? len : 1;
+		ramp.compute_slope(steps[idx].value, glidelen);
+		ramp.len = steps[idx].length - ramp.phase;
+		ramp.len = ramp.len > 1 ? ramp.len : 1;
+	}
+}
+
+void SEQ8::advance(int32_t n) {
+	int32_t k, g;
+	while (n > 0) {
+		if (ext_clock) {
+			if (clocked) {
+				clocked = false;
+				next();
+			}
+			// Step length is unknown; phase only needs to cover the glide
+			k = n;
+		}
+		else {
+			if (ramp.phase >= ramp.len) 
+				next();
+			k = ramp.remaining(n);
+		}
+		if (ramp.phase < glidelen) {
+			g = glidelen - ramp.phase;
+			g = g < k ? g : k;
+			ramp.move(g);
+		}
+		ramp.phase += k;
+		if (ext_clock && ramp.phase > glidelen)
+			ramp.phase = glidelen;
+		n -= k;
 	}
 }
 
 uint16_t SEQ8::render() {
 	if (n_steps == 0)
 		return SEQ8_DFLT_VALUE;
-	if (!gated)
-		return int_value;
-	if (phase >= len) 
-		next();
-	if (phase < glidelen) {
-		value += slope;
-		int_value = (int16_t)value.getInteger();
-		int_value = int_value > SEQ8_LEV_MIN ? int_value : SEQ8_LEV_MIN;
-		int_value = int_value < SEQ8_LEV_MAX ? int_value : SEQ8_LEV_MAX;
+	if (gated)
+		tick();
+	return ramp.level();
+}
+
+uint16_t SEQ8::render_fine() {
+	if (n_steps == 0)
+		return SEQ8_DFLT_VALUE << GenRamp::FINE_SHIFT;
+	if (gated)
+		tick();
+	return ramp.fine_level();
+}
+
+void SEQ8::tick() {
+	int32_t n = ramp.control_samples();
+	if (n) {
+		advance(n);
+		ramp.interpolate(ramp.value);
 	}
-	phase++;
-	return int_value;
+	ramp.next();
 }
 
 
@@ -75,14 +113,144 @@ void SEQ8::next() {
 			eos_handler(eos_userdata);
 	}
 	if (uniform_step)
-		len = steplen;
+		ramp.len = steplen;
 	else
-		len = steps[step_idx].length;		
-	compute_slope(value, steps[step_idx].value, glidelen);
-	phase = 0;
+		ramp.len = steps[step_idx].length;		
+	ramp.compute_slope(steps[step_idx].value, glidelen);
+	ramp.phase = 0;
+}
+
+void SEQ8::set_position(uint32_t t) {
+	uint32_t total = 0;
+	uint16_t i;
+	if (n_steps == 0 || ext_clock)
+		return;
+	for (i = 0; i < n_steps; i++)
+		total += uniform_step ? steplen : steps[i].length;
+	if (total == 0)
+		return;
+
+	// Find the step, then glide into it from the previous step's value
+	t %= total;
+	for (i = 0; i < n_steps - 1; i++) {
+		uint32_t len = uniform_step ? steplen : steps[i].length;
+		if (t < len)
+			break;
+		t -= len;
+	}
+	ramp.value = steps[i ? i - 1 : n_steps - 1].value;
+	step_idx = i;
+	ramp.len = uniform_step ? steplen : steps[i].length;
+	ramp.compute_slope(steps[i].value, glidelen);
+	ramp.phase = 0;
+	advance(t);
+	ramp.jump();
 }
 
-void SEQ8::compute_slope(SQ9x22 x0, SQ9x22 x1, int32_t len) {
-	slope = x1 - x0;
-	slope = static_cast<float>(slope) / (float)glidelen;
+void SEQ8::euclid(uint16_t k, uint16_t n, int16_t rot, uint16_t on, uint16_t off) {
+	n = n < SEQ8_MAX_STEPS ? n : SEQ8_MAX_STEPS;
+	k = k < n ? k : n;
+	n_steps = 0;
+	for (uint16_t i = 0; i < n; i++)
+		append_step(((uint32_t)i * k) % n < k ? on : off);
+	rotate(rot);
+}
+
+void SEQ8::random_walk(uint32_t seed, uint16_t n, uint16_t start, uint16_t max_step) {
+	int32_t x = start < SEQ8_LEV_MAX ? start : SEQ8_LEV_MAX;
+	uint32_t r = seed ? seed : 1;
+	n = n < SEQ8_MAX_STEPS ? n : SEQ8_MAX_STEPS;
+	n_steps = 0;
+	for (uint16_t i = 0; i < n; i++) {
+		append_step(x);
+		// xorshift32
+		r ^= r << 13;
+		r ^= r >> 17;
+		r ^= r << 5;
+		x += (int32_t)(r % (2 * (uint32_t)max_step + 1)) - max_step;
+		// Reflect off the ends of the range
+		if (x < SEQ8_LEV_MIN)
+			x = 2 * SEQ8_LEV_MIN - x;
+		if (x > SEQ8_LEV_MAX)
+			x = 2 * SEQ8_LEV_MAX - x;
+		x = x > SEQ8_LEV_MIN ? x : SEQ8_LEV_MIN;
+	}
+}
+
+void SEQ8::save(Preset &p) {
+	p.put(steplen);
+	p.put(glidelen);
+	p.put(glide_curve);
+	p.put(uniform_step);
+	p.put(ramp.control_period());
+	p.put(n_steps);
+	for (uint16_t i = 0; i < n_steps; i++) {
+		p.put((uint16_t)steps[i].value.getInteger());
+		p.put(steps[i].length);
+	}
+}
+
+bool SEQ8::load(Preset &p) {
+	int32_t step, glide, len;
+	int8_t curve;
+	bool uniform;
+	uint16_t ctl, n, val;
+	if (!(p.get(step) && p.get(glide) && p.get(curve) && p.get(uniform) && p.get(ctl) && p.get(n)))
+		return false;
+	if (n > SEQ8_MAX_STEPS || p.remaining() < n * (sizeof(val) + sizeof(len)))
+		return false;
+	set_step_length(step);
+	set_glide_length(glide);
+	set_glide_curve(curve);
+	uniform_step = uniform;
+	set_control_period(ctl);
+	n_steps = 0;
+	for (uint16_t i = 0; i < n; i++) {
+		p.get(val);
+		p.get(len);
+		append_step(val, len);
+	}
+	// Keep playing from the current step if the new pattern has it
+	if (step_idx >= n_steps)
+		reset();
+	return true;
+}
+
+void SEQ8::rotate(int16_t k) {
+	if (n_steps < 2)
+		return;
+	k %= (int16_t)n_steps;
+	if (k < 0)
+		k += n_steps;
+	if (k == 0)
+		return;
+	// Rotate right by k: reverse all, then each part
+	reverse_range(0, n_steps);
+	reverse_range(0, k);
+	reverse_range(k, n_steps);
+}
+
+void SEQ8::transpose(int16_t d) {
+	int32_t x;
+	for (uint16_t i = 0; i < n_steps; i++) {
+		x = steps[i].value.getInteger() + d;
+		x = x > SEQ8_LEV_MIN ? x : SEQ8_LEV_MIN;
+		x = x < SEQ8_LEV_MAX ? x : SEQ8_LEV_MAX;
+		steps[i].value = GenFixed((int32_t)x);
+	}
+}
+
+void SEQ8::reverse() {
+	reverse_range(0, n_steps);
+}
+
+void SEQ8::reverse_range(uint16_t first, uint16_t last) {
+	seq_step_t tmp;
+	while (first + 1 < last) {
+		last--;
+		tmp = steps[first];
+		steps[first] = steps[last];
+		steps[last] = tmp;
+		first++;
+	}
 }
\ No newline at end of file
@@ -4,12 +4,13 @@
 #ifndef SEQ8_H
 #define SEQ8_H
 
-#include <FixedPoints.h>
-#include <FixedPointsCommon.h>
+#include "Ramp.h"
+#include "Timebase.h"
+#include "Preset.h"
 
-#define SEQ8_LEN_MAX 2147483647
-#define SEQ8_LEV_MAX 255
-#define SEQ8_LEV_MIN 0
+#define SEQ8_LEN_MAX GEN_LEN_MAX
+#define SEQ8_LEV_MAX GEN_LEV_MAX
+#define SEQ8_LEV_MIN GEN_LEV_MIN
 
 // Allow user redefinition of max step array size
 #ifndef SEQ8_MAX_STEPS
@@ -21,19 +22,17 @@
 #define SEQ8_DFLT_VALUE 0
 #define SEQ8_DFLT_LEN 1
 
-using SQ9x22 = SFixed<9, 22>;
-
 // Sequencer class
 class SEQ8 {
 
 	// Sequencer step type
 	typedef struct seq_step_t {
-		SQ9x22 value;				// Destination value
+		GenFixed value;				// Destination value
 		int32_t length;				// Step length
 		// Constructors
-		seq_step_t() : value(SQ9x22(SEQ8_DFLT_VALUE)), length(SEQ8_DFLT_LEN) {}
-		seq_step_t(uint8_t val, int32_t len) 
-		: value(SQ9x22(val)), length(len) {}
+		seq_step_t() : value(GenFixed(SEQ8_DFLT_VALUE)), length(SEQ8_DFLT_LEN) {}
+		seq_step_t(uint16_t val, int32_t len) 
+		: value(GenFixed(val)), length(len) {}
 	} seq_step_t;
 
 public:
@@ -46,25 +45,69 @@ public:
 	void set_step_length(uint32_t length);
 	void set_glide_length(uint32_t length);
 
+	// Set uniform step length/glide time in milliseconds
+	void set_step_length(UQ16x16 ms, const Timebase &tb)	{ set_step_length(tb.ms_to_samples(ms)); }
+	void set_glide_length(UQ16x16 ms, const Timebase &tb)	{ set_glide_length(tb.ms_to_samples(ms)); }
+
+	// Glide shape: curvature [-CURVE_MAX, CURVE_MAX], 0 for linear (see
+	// Curve.h). Takes effect at the next step.
+	void set_glide_curve(int8_t c)	{ glide_curve = curve_prepare(c); ramp.set_curve(glide_curve); }
+
 	// Add a step with the current length or specific length
-	void append_step(uint8_t value);
-	void append_step(uint8_t value, int32_t length);
+	void append_step(uint16_t value);
+	void append_step(uint16_t value, int32_t length);
 
 	// Set value/length of a specific step
-	void set_step(uint16_t idx, uint8_t value);
-	void set_step(uint16_t idx, uint8_t value, int32_t length);
+	void set_step(uint16_t idx, uint16_t value);
+	void set_step(uint16_t idx, uint16_t value, int32_t length);
 
 	// Clear steps (does not actually erase existing steps, just ignores them)
 	void clear()			{ n_steps = 0; }
 
+	// Pattern generators; replace the sequence with n steps of the uniform
+	// step length
+	// - Euclidean rhythm: k onsets spread evenly over n steps, rotated by rot
+	void euclid(uint16_t k, uint16_t n, int16_t rot = 0,
+		uint16_t on = SEQ8_LEV_MAX, uint16_t off = SEQ8_LEV_MIN);
+	// - Random walk from start, moving at most max_step per step; the same seed
+	//   always gives the same pattern
+	void random_walk(uint32_t seed, uint16_t n, uint16_t start, uint16_t max_step);
+
+	// Pattern transforms
+	void rotate(int16_t k);			// Shift steps k places later (wrapping)
+	void transpose(int16_t d);		// Add d to every step value (clamped)
+	void reverse();
+
 	// Activate/deactivate
 	void gate(bool is_high)	{ gated = is_high; }
 
 	// Reset sequencer to step 0
-	void reset() 			{ phase = len; step_idx = n_steps; }
+	void reset() 			{ ramp.phase = ramp.len; step_idx = n_steps; }
+
+	// Jump to the position t samples after the start of step 0 (e.g. a
+	// synchronized clock's time, so sequences with the same steps line up).
+	// Ignored with an external clock.
+	void set_position(uint32_t t);
+
+	// Step on clock() calls (e.g. ClockTracker edges) instead of step lengths
+	void set_external_clock(bool ext)	{ ext_clock = ext; clocked = false; }
 
-	// Main render method
+	// Move to the next step on the next rendered sample (external clock mode)
+	void clock()			{ clocked = true; }
+
+	// Update state every n samples (rounded down to a power of two, up to 256)
+	// and linearly interpolate the samples in between; 1 updates every sample
+	void set_control_period(uint16_t n)	{ ramp.set_control_period(n); }
+
+	// Append the parameters and steps to a preset / restore them; load() changes
+	// nothing and returns false if the preset is too short
+	void save(Preset &p);
+	bool load(Preset &p);
+
+	// Main render method, and the same with GenRamp::FINE_SHIFT fractional bits
+	// (for a Dither8 output stage)
 	uint16_t render();
+	uint16_t render_fine();
 
 	// Setter for user callback on end of sequence
 	void set_eos_handler(void (*handler)(void *), void *userdata) {
@@ -72,32 +115,37 @@ public:
 		eos_userdata = userdata;
 	}
 
-	// Get number of steps
+	// Get number of steps and the index of the current step
 	uint16_t num_steps()	{ return n_steps; }
+	uint16_t current_step()	{ return step_idx < n_steps ? step_idx : 0; }
 
 	// Directly settable parameter(s)
 	bool uniform_step;	// Whether to use individual step length or uniform length
 
 protected:
 
-	void compute_slope(SQ9x22 x0, SQ9x22 x1, int32_t len);
-
 	void next();
 
+	// Reverse steps [first, last)
+	void reverse_range(uint16_t first, uint16_t last);
+
+	// Advance n samples, through step changes if needed
+	void advance(int32_t n);
+	void tick();
+
 	bool gated;		// Whether the sequencer gate is set high
+	bool ext_clock;	// Whether steps follow clock() instead of step lengths
+	volatile bool clocked;	// Clock edge pending
 
-	SQ9x22 value;				// Current value
-	SQ9x22 slope;				// Current slope
-	int16_t int_value;			// Current value, casted and constrained to [0, 255]
+	GenRamp ramp;				// Value, slope, phase and length of the current step
 	int32_t	steplen;			// Uniform length for all steps (if used)			
 
 	seq_step_t steps[SEQ8_MAX_STEPS];		// Step array
 	uint16_t n_steps;						// Number of steps added
 	uint16_t step_idx;						// Current step index			
 	
-	uint32_t phase;		// Current phase in current step
-	int32_t len;		// Length of current step
 	int32_t glidelen;	// Glide time
+	int8_t glide_curve;	// Glide curvature
 
 	void (*eos_handler)(void *);	// User callback for end of sequence
 	void *eos_userdata;				// - its userdata
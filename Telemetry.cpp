@@ -0,0 +1,70 @@
+#include "Telemetry.h"
+
+Telemetry::Telemetry(OSCManager &osc, const char *path) :
+osc(osc), path(path), n_signals(0), pending_mask(0), mask(0), n_subscribed(0),
+frame_limit(0), decimation(TLM_DFLT_DECIMATION), max_frames(0), count(0),
+n_values(0), w(0), ready(-1), seq(0), n_dropped(0) {
+
+}
+
+int Telemetry::add_signal(const volatile uint16_t *value) {
+	if (n_signals >= TLM_MAX_SIGNALS)
+		return -1;
+	signals[n_signals] = value;
+	return n_signals++;
+}
+
+void Telemetry::record() {
+
+	if (n_values == 0)
+		start_blob();
+	if (!n_subscribed)
+		return;
+
+	uint16_t *buff = buffers[w];
+	for (uint8_t i = 0; i < n_signals; i++) {
+		if (mask >> i & 1)
+			buff[n_values++] = *signals[i];
+	}
+
+	// Hand the full buffer to loop(), or record over it if loop() is behind
+	if (n_values >= frame_limit * n_subscribed) {
+		if (ready < 0) {
+			lengths[w] = n_values;
+			masks[w] = mask;
+			ready = w;
+			w ^= 1;
+		}
+		else
+			n_dropped++;
+		n_values = 0;
+	}
+}
+
+void Telemetry::start_blob() {
+	mask = pending_mask;
+	n_subscribed = 0;
+	for (uint8_t i = 0; i < n_signals; i++)
+		n_subscribed += mask >> i & 1;
+	if (!n_subscribed)
+		return;
+	frame_limit = TLM_BUFFER_LEN / n_subscribed;
+	if (max_frames && max_frames < frame_limit)
+		frame_limit = max_frames;
+}
+
+bool Telemetry::loop() {
+	if (ready < 0)
+		return false;
+
+	int8_t r = ready;
+	OSCMessage msg(path);
+	msg.add((int32_t)seq++);
+	msg.add((int32_t)masks[r]);
+	msg.add((int32_t)decimation);
+	msg.add((uint8_t *)buffers[r], lengths[r] * sizeof(uint16_t));
+	osc.send(msg);
+
+	ready = -1;
+	return true;
+}
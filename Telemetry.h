@@ -0,0 +1,99 @@
+/*
+ *	Telemetry.h
+ */
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "Arduino.h"
+#include "OSCManager.h"
+
+// Allow user redefinition of table and buffer sizes
+#ifndef TLM_MAX_SIGNALS
+#define TLM_MAX_SIGNALS 8
+#endif
+#ifndef TLM_BUFFER_LEN
+#define TLM_BUFFER_LEN 256		// Values per blob (uint16_t)
+#endif
+
+// Defaults
+#define TLM_DFLT_DECIMATION 64
+
+// Streams selected signals over OSC. Signals are registered as variables the
+// render callback keeps up to date (like ModMatrix sources); tick() records the
+// subscribed ones every n samples into one of two preallocated buffers, and
+// loop() sends each full buffer as one message:
+//
+//	<path> <int seq> <int mask> <int decimation> <blob>
+//
+// where the blob holds frames of the subscribed signals' values (uint16_t,
+// little-endian, lowest signal index first). seq counts blobs, so gaps show
+// lost or dropped packets.
+class Telemetry {
+
+public:
+
+	Telemetry(OSCManager &osc, const char *path = "/telemetry");
+
+	// Register a signal; returns its index or -1 if the table is full
+	int add_signal(const volatile uint16_t *value);
+
+	// Select signals to stream (bit i streams signal i; 0 stops streaming).
+	// Takes effect at the next blob.
+	void subscribe(uint32_t mask)		{ pending_mask = mask & ((1UL << n_signals) - 1); }
+
+	// Record a frame every n samples
+	void set_decimation(uint16_t n)		{ decimation = n > 0 ? n : 1; }
+
+	// Limit frames per blob (0 fills the buffer), trading packet rate for latency
+	void set_max_frames(uint16_t n)		{ max_frames = n; }
+
+	// Call once per sample from the render callback
+	void tick() {
+		if (!mask && !pending_mask)
+			return;
+		if (++count >= decimation) {
+			count = 0;
+			record();
+		}
+	}
+
+	// Send a full buffer if one is waiting; call from loop(). Returns true if
+	// a blob was sent.
+	bool loop();
+
+	// Blobs discarded because the previous one had not been sent yet
+	uint32_t dropped()					{ return n_dropped; }
+
+protected:
+
+	void record();
+	void start_blob();
+
+	OSCManager &osc;
+	const char *path;
+
+	const volatile uint16_t *signals[TLM_MAX_SIGNALS];
+	uint8_t n_signals;
+
+	volatile uint32_t pending_mask;		// Subscription for the next blob
+	uint32_t mask;						// Subscription of the blob being recorded
+	uint8_t n_subscribed;
+	uint16_t frame_limit;				// Frames in the blob being recorded
+	uint16_t decimation;
+	uint16_t max_frames;
+	uint16_t count;
+
+	// Double buffer: the render callback records into buffer w while loop()
+	// sends buffer ready (-1 if none)
+	uint16_t buffers[2][TLM_BUFFER_LEN];
+	uint16_t lengths[2];
+	uint32_t masks[2];
+	uint16_t n_values;
+	uint8_t w;
+	volatile int8_t ready;
+
+	uint32_t seq;
+	volatile uint32_t n_dropped;
+};
+
+#endif
@@ -0,0 +1,80 @@
+/*
+ *	Timebase.h
+ */
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#include <stdint.h>
+#include <FixedPoints.h>
+#include <FixedPointsCommon.h>
+
+#define TB_DFLT_SAMPLE_RATE 16000
+
+// Converts between milliseconds, Hz and samples at a given sample rate. Scale
+// factors are computed once by set_sample_rate(), so conversions are integer
+// multiplies and shifts (hz_to_period() needs one integer division) instead of
+// soft-float math. Times and rates are UQ16x16: up to 65535ms or 65535Hz with
+// 1/65536 resolution; integer arguments convert without float math. Handlers
+// taking times from OSC should pass a float, which has no 65535ms limit.
+class Timebase {
+
+public:
+
+	Timebase(uint32_t rate = TB_DFLT_SAMPLE_RATE)	{ set_sample_rate(rate); }
+
+	void set_sample_rate(uint32_t rate) {
+		fs = rate > 0 ? rate : 1;
+		period_us = 1000000 / fs;
+		ms_scale = ((uint64_t)fs << 16) / 1000;
+		sample_ms_scale = ((uint64_t)1000 << 32) / fs;
+		phase_scale = ((uint64_t)1 << 40) / fs;
+	}
+
+	uint32_t sample_rate() const		{ return fs; }
+
+	// Sample period in whole microseconds (for the sample timer)
+	uint32_t sample_period_us() const	{ return period_us; }
+
+	// Milliseconds to samples
+	uint32_t ms_to_samples(UQ16x16 ms) const {
+		return ((uint64_t)ms.getInternal() * ms_scale) >> 32;
+	}
+
+	// Milliseconds to samples from an OSC argument; times over the 65535ms a
+	// UQ16x16 holds are converted in whole milliseconds instead of wrapping
+	uint32_t ms_to_samples(float ms) const {
+		if (ms <= 0)
+			return 0;
+		if (ms < 65535)
+			return ms_to_samples(UQ16x16(ms));
+		uint64_t n = ((uint64_t)(ms < 4.0e9f ? ms : 4.0e9f) * ms_scale) >> 16;
+		return n < 0xFFFFFFFF ? n : 0xFFFFFFFF;
+	}
+
+	// Samples to whole milliseconds
+	uint32_t samples_to_ms(uint32_t samples) const {
+		return ((uint64_t)samples * sample_ms_scale) >> 32;
+	}
+
+	// Period in samples of a frequency in Hz
+	uint32_t hz_to_period(UQ16x16 hz) const {
+		if (hz.getInternal() == 0)
+			return 0xFFFFFFFF;
+		return ((uint64_t)fs << 16) / hz.getInternal();
+	}
+
+	// Per-sample increment of a 32-bit phase accumulator at a frequency in Hz
+	uint32_t hz_to_phase_inc(UQ16x16 hz) const {
+		return ((uint64_t)hz.getInternal() * phase_scale) >> 24;
+	}
+
+protected:
+
+	uint32_t fs;				// Sample rate (Hz)
+	uint32_t period_us;			// Sample period (microseconds)
+	uint32_t ms_scale;			// Samples per millisecond, Q16
+	uint64_t sample_ms_scale;	// Milliseconds per sample, Q32
+	uint64_t phase_scale;		// 2^32 / sample rate, Q8
+};
+
+#endif
@@ -0,0 +1,231 @@
+#include "UDPQueue.h"
+#include <string.h>
+
+#ifdef ARDUINO
+#include "lwip/udp.h"
+#include "lwip/pbuf.h"
+
+static uint32_t now_us() {
+	return micros();
+}
+
+static bool push_pbuf(UDPQueue *queue, pbuf *p, uint32_t addr, uint16_t port) {
+	if (p->tot_len <= UDPQ_PACKET_LEN && p->next == NULL)
+		return queue->push((const uint8_t *)p->payload, p->len, addr, port);
+	// Chained (or too long; push() counts it)
+	uint8_t buff[UDPQ_PACKET_LEN];
+	size_t len = p->tot_len <= UDPQ_PACKET_LEN ? pbuf_copy_partial(p, buff, p->tot_len, 0) : p->tot_len;
+	return queue->push(buff, len, addr, port);
+}
+
+// lwIP receive callback
+static void on_receive(void *arg, udp_pcb *pcb, pbuf *p, const ip_addr_t *addr, u16_t port) {
+	UDPQueue *queue = (UDPQueue *)arg;
+	uint32_t from = ip4_addr_get_u32(ip_2_ip4(addr));
+
+	// Behind held packets, or with the ring full, keep the pbuf
+	if ((queue->held() || !push_pbuf(queue, p, from, port)) && queue->hold(p, from, port))
+		return;
+	pbuf_free(p);
+}
+#else
+#include <time.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+static uint32_t now_us() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+#endif
+
+UDPQueue::UDPQueue() : head(0), tail(0), fast_handler(NULL), fast_userdata(NULL),
+n_received(0), n_fast(0), n_dropped(0),
+#ifdef ARDUINO
+pcb(NULL), held_head(0), held_tail(0) {
+#else
+fd(-1), running(false) {
+#endif
+
+}
+
+UDPQueue::~UDPQueue() {
+	stop();
+}
+
+bool UDPQueue::push(const uint8_t *data, size_t len, uint32_t addr, uint16_t port) {
+	if (len > UDPQ_PACKET_LEN) {
+		n_received++;
+		n_dropped++;
+		return true;
+	}
+
+	// Fill the next slot, or the spare if the consumer is behind
+	bool full = (uint8_t)(head - __atomic_load_n(&tail, __ATOMIC_ACQUIRE)) >= UDPQ_SLOTS;
+	UDPPacket &packet = full ? spare : slots[head & (UDPQ_SLOTS - 1)];
+	memcpy(packet.data, data, len);
+	packet.len = len;
+	packet.addr = addr;
+	packet.port = port;
+	packet.time_us = now_us();
+
+	if (fast_handler && fast_handler(packet, fast_userdata))
+		n_fast++;
+	else if (full)
+		return false;
+	else
+		__atomic_store_n(&head, (uint8_t)(head + 1), __ATOMIC_RELEASE);
+	n_received++;
+	return true;
+}
+
+#ifdef ARDUINO
+bool UDPQueue::hold(pbuf *p, uint32_t addr, uint16_t port) {
+	n_received++;
+	if (p->tot_len > UDPQ_PACKET_LEN || held() >= UDPQ_HELD) {
+		n_dropped++;
+		return false;
+	}
+	UDPHeld &h = held_packets[held_head & (UDPQ_HELD - 1)];
+	h.p = p;
+	h.addr = addr;
+	h.port = port;
+	h.time_us = now_us();
+	held_head++;
+	return true;
+}
+
+void UDPQueue::pop() {
+	__atomic_store_n(&tail, (uint8_t)(tail + 1), __ATOMIC_RELEASE);
+
+	// Move the oldest held packet into the freed slot
+	if (!held())
+		return;
+	UDPHeld &h = held_packets[held_tail & (UDPQ_HELD - 1)];
+	UDPPacket &packet = slots[head & (UDPQ_SLOTS - 1)];
+	packet.len = pbuf_copy_partial(h.p, packet.data, h.p->tot_len, 0);
+	packet.addr = h.addr;
+	packet.port = h.port;
+	packet.time_us = h.time_us;
+	pbuf_free(h.p);
+	held_tail++;
+	__atomic_store_n(&head, (uint8_t)(head + 1), __ATOMIC_RELEASE);
+}
+#else
+void UDPQueue::pop() {
+	__atomic_store_n(&tail, (uint8_t)(tail + 1), __ATOMIC_RELEASE);
+}
+#endif
+
+#ifdef ARDUINO
+bool UDPQueue::begin(uint16_t port) {
+	stop();
+	pcb = udp_new();
+	if (!pcb)
+		return false;
+	if (udp_bind(pcb, IP_ADDR_ANY, port) != ERR_OK) {
+		udp_remove(pcb);
+		pcb = NULL;
+		return false;
+	}
+	udp_recv(pcb, on_receive, this);
+	return true;
+}
+
+void UDPQueue::stop() {
+	if (pcb) {
+		udp_remove(pcb);
+		pcb = NULL;
+	}
+	for (; held(); held_tail++)
+		pbuf_free(held_packets[held_tail & (UDPQ_HELD - 1)].p);
+}
+
+bool UDPQueue::send(const uint8_t *data, size_t len, uint32_t addr, uint16_t port) {
+	if (!pcb)
+		return false;
+	pbuf *p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+	if (!p)
+		return false;
+	pbuf_take(p, data, len);
+	ip_addr_t dest;
+	ip_addr_set_ip4_u32(&dest, addr);
+	err_t err = udp_sendto(pcb, p, &dest, port);
+	pbuf_free(p);
+	return err == ERR_OK;
+}
+#else
+bool UDPQueue::begin(uint16_t port) {
+	stop();
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0)
+		return false;
+	int on = 1;
+	setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &on, sizeof(on));
+
+	// Wake up periodically to notice stop()
+	struct timeval timeout = {0, 100000};
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	struct sockaddr_in local;
+	memset(&local, 0, sizeof(local));
+	local.sin_family = AF_INET;
+	local.sin_addr.s_addr = htonl(INADDR_ANY);
+	local.sin_port = htons(port);
+	if (bind(fd, (struct sockaddr *)&local, sizeof(local)) < 0) {
+		close(fd);
+		fd = -1;
+		return false;
+	}
+	running = true;
+	if (pthread_create(&thread, NULL, receive_thread, this) != 0) {
+		running = false;
+		close(fd);
+		fd = -1;
+		return false;
+	}
+	return true;
+}
+
+void UDPQueue::stop() {
+	if (fd < 0)
+		return;
+	running = false;
+	pthread_join(thread, NULL);
+	close(fd);
+	fd = -1;
+}
+
+bool UDPQueue::send(const uint8_t *data, size_t len, uint32_t addr, uint16_t port) {
+	if (fd < 0)
+		return false;
+	struct sockaddr_in dest;
+	memset(&dest, 0, sizeof(dest));
+	dest.sin_family = AF_INET;
+	dest.sin_addr.s_addr = addr;
+	dest.sin_port = htons(port);
+	return sendto(fd, data, len, 0, (struct sockaddr *)&dest, sizeof(dest)) == (ssize_t)len;
+}
+
+// Stands in for the lwIP callback: blocks on the socket and pushes each datagram
+void *UDPQueue::receive_thread(void *arg) {
+	UDPQueue *queue = (UDPQueue *)arg;
+	uint8_t buff[UDPQ_PACKET_LEN];
+	while (queue->running) {
+		struct sockaddr_in remote;
+		socklen_t remote_len = sizeof(remote);
+		// MSG_TRUNC returns the full length of a long packet, so push() drops it
+		ssize_t len = recvfrom(queue->fd, buff, sizeof(buff), MSG_TRUNC,
+			(struct sockaddr *)&remote, &remote_len);
+		if (len < 0)
+			continue;		// Timeout or interrupted
+		// With the ring full, wait; later datagrams stay in the socket's buffer
+		while (!queue->push(buff, len, remote.sin_addr.s_addr, ntohs(remote.sin_port)) && queue->running)
+			usleep(1000);
+	}
+	return NULL;
+}
+#endif
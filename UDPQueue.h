@@ -0,0 +1,141 @@
+/*
+ *	UDPQueue.h
+ */
+#ifndef UDPQUEUE_H
+#define UDPQUEUE_H
+
+#ifdef ARDUINO
+#include "Arduino.h"
+struct udp_pcb;
+struct pbuf;
+#else
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#endif
+
+// Allow user redefinition of the queue size
+#ifndef UDPQ_SLOTS
+#define UDPQ_SLOTS 8				// Packets held (power of 2)
+#endif
+#ifndef UDPQ_PACKET_LEN
+#define UDPQ_PACKET_LEN 256			// Largest packet held or sent (bytes)
+#endif
+#ifndef UDPQ_HELD
+#define UDPQ_HELD 64				// Packets left in lwIP while the ring is full (power of 2)
+#endif
+
+// Received datagram
+struct UDPPacket {
+	uint32_t addr;					// Sender's IPv4 address (network order, as IPAddress)
+	uint16_t port;					// Sender's port
+	uint16_t len;					// Bytes of data
+	uint32_t time_us;				// Arrival time (micros())
+	uint8_t data[UDPQ_PACKET_LEN];
+};
+
+// UDP socket that receives through a callback instead of polling. On ESP8266
+// the callback is registered with lwIP (udp_recv()) and copies each datagram
+// into a preallocated single-producer/single-consumer ring as lwIP delivers
+// it; loop() code takes them with front() and pop(), so nothing waits in lwIP
+// for the main loop. Packets longer than UDPQ_PACKET_LEN are dropped and
+// counted.
+//
+// A burst larger than the ring (e.g. 50 messages from a Max patch) is not
+// dropped: while the ring is full, packets stay in the pbufs lwIP delivered
+// them in, up to UDPQ_HELD of them, and pop() copies the oldest into the ring
+// as slots free up, as WiFiUDP keeps its receive chain. Only packets beyond
+// that are dropped. The held pbufs come from the heap, like WiFiUDP's.
+//
+// A fast handler sees each packet in the callback first and may consume it,
+// e.g. to apply a /gate without waiting for the main loop's OSC task. lwIP
+// callbacks run in the system task, between loop() calls and at yields, never
+// inside loop() code, so a fast handler may use the same objects as OSC
+// handlers, but it should be short.
+//
+// Without ARDUINO, a POSIX socket read by a thread stands in for lwIP, so the
+// same path runs on Linux; the fast handler is then called on that thread,
+// and packets wait in the socket's buffer while the ring is full.
+class UDPQueue {
+
+public:
+
+	UDPQueue();
+	~UDPQueue();
+
+	// Start/stop receiving on a port
+	bool begin(uint16_t port);
+	void stop();
+
+	// Send a datagram from the bound port
+	bool send(const uint8_t *data, size_t len, uint32_t addr, uint16_t port);
+
+	// Set the function called with each packet in the receive callback; it
+	// returns true if it handled the packet, otherwise the packet is queued
+	void set_fast_handler(bool (*handler)(UDPPacket &, void *), void *userdata) {
+		fast_handler = handler;
+		fast_userdata = userdata;
+	}
+
+	// Oldest queued packet, or NULL if none; pop() releases it
+	UDPPacket *front() {
+		if (__atomic_load_n(&head, __ATOMIC_ACQUIRE) == tail)
+			return NULL;
+		return &slots[tail & (UDPQ_SLOTS - 1)];
+	}
+	void pop();
+	uint8_t available()					{ return __atomic_load_n(&head, __ATOMIC_ACQUIRE) - tail; }
+
+	// Copy a received datagram in (receive callback). Returns false, without
+	// counting it, if the ring is full and the fast handler didn't take it
+	bool push(const uint8_t *data, size_t len, uint32_t addr, uint16_t port);
+
+#ifdef ARDUINO
+	// Keep a pbuf received while the ring is full (receive callback); returns
+	// false if it is too long or UDPQ_HELD are already held (it is dropped)
+	bool hold(pbuf *p, uint32_t addr, uint16_t port);
+	uint8_t held()						{ return held_head - held_tail; }
+#endif
+
+	// Counters
+	uint32_t received()					{ return n_received; }
+	uint32_t fast()						{ return n_fast; }		// Consumed by the fast handler
+	uint32_t dropped()					{ return n_dropped; }	// Too long, or ring and held full
+
+protected:
+
+	UDPPacket slots[UDPQ_SLOTS];
+	UDPPacket spare;				// For the fast handler while the ring is full
+	uint8_t head;					// Written by the receive callback
+	uint8_t tail;					// Written by the consumer
+
+	bool (*fast_handler)(UDPPacket &, void *);
+	void *fast_userdata;
+
+	volatile uint32_t n_received;
+	volatile uint32_t n_fast;
+	volatile uint32_t n_dropped;
+
+#ifdef ARDUINO
+	udp_pcb *pcb;
+
+	// Packets waiting in lwIP buffers. The receive callback runs in the system
+	// task and pop() in loop(), which never preempt each other
+	struct UDPHeld {
+		pbuf *p;
+		uint32_t addr;
+		uint16_t port;
+		uint32_t time_us;
+	};
+	UDPHeld held_packets[UDPQ_HELD];
+	uint8_t held_head;
+	uint8_t held_tail;
+#else
+	int fd;
+	pthread_t thread;
+	volatile bool running;
+	static void *receive_thread(void *arg);
+#endif
+};
+
+#endif
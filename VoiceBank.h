@@ -0,0 +1,302 @@
+/*
+ *	VoiceBank.h
+ */
+#ifndef VOICEBANK_H
+#define VOICEBANK_H
+
+#include "Arduino.h"
+#include "Ramp.h"
+
+#define VB_LEN_MAX GEN_LEN_MAX
+#define VB_LEV_MAX GEN_LEV_MAX
+#define VB_LEV_MIN GEN_LEV_MIN
+
+// Banks hold up to 32 voices so voice states fit in one bitmask
+#define VB_MAX_VOICES 32
+
+// Voice banks render N LFOs or envelopes that behave like LFO8 and ADSR8, with
+// per-voice state kept in parallel arrays. Only voices whose bit is set in the
+// active mask are computed on each tick; the others hold their last output.
+template <uint8_t N>
+class VoiceBankBase {
+
+	static_assert(N > 0 && N <= VB_MAX_VOICES, "VoiceBank supports 1-32 voices");
+
+public:
+
+	// Last rendered value of each voice
+	const uint16_t *outputs()			{ return out; }
+	uint16_t output(uint8_t v)			{ return out[v]; }
+
+	// Average of all voices
+	uint16_t mix() {
+		uint32_t sum = 0;
+		for (int v = 0; v < N; v++)
+			sum += out[v];
+		return sum / N;
+	}
+
+	// Bitmask of voices computed on each tick
+	uint32_t active_voices()			{ return active; }
+
+protected:
+
+	VoiceBankBase() : active(0) {
+		for (int v = 0; v < N; v++) {
+			value[v] = 0;
+			slope[v] = 0;
+			phase[v] = 0;
+			len[v] = 1;
+			out[v] = 0;
+		}
+	}
+
+	void compute_slope(uint8_t v, GenFixed x1, int32_t new_len) {
+		len[v] = new_len > 1 ? new_len : 1;
+		slope[v] = x1 - value[v];
+		slope[v] = static_cast<float>(slope[v]) / (float)len[v];
+	}
+
+	// Add the slope and store the constrained output of voice v
+	void step(uint8_t v) {
+		value[v] += slope[v];
+		phase[v]++;
+		out[v] = GenRamp::constrain_level(value[v]);
+	}
+
+	uint32_t active;			// Voices computed on each tick
+
+	GenFixed value[N];			// Current fixed point values
+	GenFixed slope[N];			// Current fixed point slopes
+	int32_t phase[N];			// Current segment phases
+	int32_t len[N];				// Current segment lengths
+	uint16_t out[N];			// Last outputs, constrained to [0, VB_LEV_MAX]
+};
+
+// Bank of N Ramp-Triangle-Ramp LFOs (see LFO8)
+template <uint8_t N>
+class LFOBank : public VoiceBankBase<N> {
+
+	using Base = VoiceBankBase<N>;
+
+	// Minimum number of samples used to recompute a segment's length when the
+	// period is changed during it
+	const int MIN_RECOMP_LEN = 8;
+
+public:
+
+	// Voices start at the end of a declining segment, so they rise first
+	LFOBank() : declining(~(uint32_t)0) {
+		for (int v = 0; v < N; v++) {
+			period[v] = 8000;
+			duty[v] = 0.5;
+			len_incline[v] = 4000;
+			len_decline[v] = 4000;
+		}
+	}
+
+	void set_period(uint8_t v, uint32_t period_samples) {
+		period[v] = period_samples < VB_LEN_MAX ? period_samples : VB_LEN_MAX;
+		recompute(v);
+	}
+
+	void set_duty_cycle(uint8_t v, float duty_norm) {
+		duty[v] = duty_norm > 0 ? duty_norm : 0;
+		duty[v] = duty[v] < 1 ? duty[v] : 1;
+		recompute(v);
+	}
+
+	// Start or stop (hold) voice v
+	void start(uint8_t v)		{ Base::active |= (uint32_t)1 << v; }
+	void stop(uint8_t v)		{ Base::active &= ~((uint32_t)1 << v); }
+
+	// Render one tick of all running voices
+	const uint16_t *render() {
+		for (uint32_t m = Base::active; m; m &= m - 1) {
+			uint8_t v = __builtin_ctz(m);
+			if (Base::phase[v] >= Base::len[v]) {
+				uint32_t bit = (uint32_t)1 << v;
+				declining ^= bit;
+				Base::phase[v] = 0;
+				if (declining & bit)
+					Base::compute_slope(v, GenFixed(VB_LEV_MIN), len_decline[v]);
+				else
+					Base::compute_slope(v, GenFixed(VB_LEV_MAX), len_incline[v]);
+			}
+			Base::step(v);
+		}
+		return Base::out;
+	}
+
+protected:
+
+	void recompute(uint8_t v) {
+		len_incline[v] = period[v] * duty[v];
+		len_decline[v] = period[v] * (1.0 - duty[v]);
+		bool decline = declining & ((uint32_t)1 << v);
+		int32_t l = (decline ? len_decline[v] : len_incline[v]) - Base::phase[v];
+		Base::phase[v] = 0;
+		Base::compute_slope(v, GenFixed(decline ? VB_LEV_MIN : VB_LEV_MAX),
+			l > MIN_RECOMP_LEN ? l : MIN_RECOMP_LEN);
+	}
+
+	uint32_t declining;			// Voices in their declining segment
+
+	int32_t period[N];
+	float duty[N];
+	int32_t len_incline[N];
+	int32_t len_decline[N];
+};
+
+// Bank of N ADSR envelopes (see ADSR8). Voices in sustain or idle hold their
+// level and cost nothing until their gate or sustain level changes.
+template <uint8_t N>
+class ADSRBank : public VoiceBankBase<N> {
+
+	using Base = VoiceBankBase<N>;
+
+	// Minimum number of samples used to recompute the length of a state when
+	// the length is changed during the state
+	const int MIN_RECOMP_LEN = 8;
+
+	enum {
+		ADSRStateIdle = 0,
+		ADSRStateAttack,
+		ADSRStateDecay,
+		ADSRStateSustain,
+		ADSRStateSustainAdjust,
+		ADSRStateRelease
+	};
+
+public:
+
+	ADSRBank() : retrigger(0), eod_handler(NULL), eod_userdata(NULL),
+	eor_handler(NULL), eor_userdata(NULL) {
+		for (int v = 0; v < N; v++) {
+			state[v] = ADSRStateIdle;
+			atk_len[v] = dec_len[v] = rel_len[v] = 160;
+			sus_lev[v] = 127;
+		}
+	}
+
+	// Parameter setters
+	void set_attack(uint8_t v, uint32_t p_len) {
+		atk_len[v] = p_len < VB_LEN_MAX ? p_len : VB_LEN_MAX;
+		if (state[v] == ADSRStateAttack)
+			recompute(v, GenFixed(VB_LEV_MAX), atk_len[v]);
+	}
+	void set_decay(uint8_t v, uint32_t p_len) {
+		dec_len[v] = p_len < VB_LEN_MAX ? p_len : VB_LEN_MAX;
+		if (state[v] == ADSRStateDecay)
+			recompute(v, sus_lev[v], dec_len[v]);
+	}
+	void set_sustain(uint8_t v, uint16_t p_lev) {
+		sus_lev[v] = p_lev;
+		if (state[v] == ADSRStateDecay)
+			recompute(v, sus_lev[v], dec_len[v]);
+		else if (state[v] == ADSRStateSustain)
+			begin(v, ADSRStateSustainAdjust, sus_lev[v], MIN_RECOMP_LEN);
+	}
+	void set_release(uint8_t v, uint32_t p_len) {
+		rel_len[v] = p_len < VB_LEN_MAX ? p_len : VB_LEN_MAX;
+		if (state[v] == ADSRStateRelease)
+			recompute(v, GenFixed(VB_LEV_MIN), rel_len[v]);
+	}
+	void set_retrigger(uint8_t v, bool retrig) {
+		if (retrig)	retrigger |= (uint32_t)1 << v;
+		else		retrigger &= ~((uint32_t)1 << v);
+	}
+
+	// Setters for user callbacks on end of Decay and Release; called with the
+	// voice index
+	void set_eod_handler(void (*handler)(uint8_t, void *), void *userdata) {
+		eod_handler = handler;
+		eod_userdata = userdata;
+	}
+	void set_eor_handler(void (*handler)(uint8_t, void *), void *userdata) {
+		eor_handler = handler;
+		eor_userdata = userdata;
+	}
+
+	// Gate
+	void gate(uint8_t v, bool is_high) {
+		if (is_high)	begin(v, ADSRStateAttack, GenFixed(VB_LEV_MAX), atk_len[v]);
+		else			begin(v, ADSRStateRelease, GenFixed(VB_LEV_MIN), rel_len[v]);
+	}
+
+	// Render one tick of all moving voices
+	const uint16_t *render() {
+		for (uint32_t m = Base::active; m; m &= m - 1) {
+			uint8_t v = __builtin_ctz(m);
+			if (Base::phase[v] >= Base::len[v]) {
+				switch (state[v]) {
+					case ADSRStateAttack:
+						begin(v, ADSRStateDecay, sus_lev[v], dec_len[v]);
+						break;
+					case ADSRStateDecay:
+						if (retrigger & ((uint32_t)1 << v))
+							begin(v, ADSRStateAttack, GenFixed(VB_LEV_MAX), atk_len[v]);
+						else
+							hold(v, ADSRStateSustain, sus_lev[v]);
+						if (eod_handler)
+							eod_handler(v, eod_userdata);
+						break;
+					case ADSRStateSustainAdjust:
+						hold(v, ADSRStateSustain, sus_lev[v]);
+						break;
+					case ADSRStateRelease:
+						hold(v, ADSRStateIdle, GenFixed(VB_LEV_MIN));
+						if (eor_handler)
+							eor_handler(v, eor_userdata);
+						break;
+					default:
+						break;
+				}
+				if (!(Base::active & ((uint32_t)1 << v)))
+					continue;
+			}
+			Base::step(v);
+		}
+		return Base::out;
+	}
+
+protected:
+
+	// Begin a moving state towards x1 over new_len samples
+	void begin(uint8_t v, uint8_t new_state, GenFixed x1, int32_t new_len) {
+		state[v] = new_state;
+		Base::phase[v] = 0;
+		Base::compute_slope(v, x1, new_len);
+		Base::active |= (uint32_t)1 << v;
+	}
+
+	// Begin a holding state at level x
+	void hold(uint8_t v, uint8_t new_state, GenFixed x) {
+		state[v] = new_state;
+		Base::value[v] = x;
+		Base::out[v] = x.getInteger();
+		Base::active &= ~((uint32_t)1 << v);
+	}
+
+	// Change the length of the current state
+	void recompute(uint8_t v, GenFixed x1, int32_t new_len) {
+		int32_t l = new_len - Base::phase[v];
+		Base::phase[v] = 0;
+		Base::compute_slope(v, x1, l > MIN_RECOMP_LEN ? l : MIN_RECOMP_LEN);
+	}
+
+	uint32_t retrigger;				// Voices that retrigger on end of decay
+
+	uint8_t state[N];				// Current states
+	int32_t atk_len[N];				// Attack state lengths
+	int32_t dec_len[N];				// Decay state lengths
+	GenFixed sus_lev[N];				// Sustain state target levels
+	int32_t rel_len[N];				// Release state lengths
+
+	void (*eod_handler)(uint8_t, void *);	// User callback for end of decay
+	void *eod_userdata;						// - its userdata
+	void (*eor_handler)(uint8_t, void *);	// User callback for end of release
+	void *eor_userdata;						// - its userdata
+};
+
+#endif
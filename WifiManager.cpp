@@ -23,7 +23,7 @@ bool WifiManager::init() {
     if (initialized) 
         return true;
     bool success;
-    EEPROM.begin(sizeof(config));
+    EEPROM.begin(EEPROM_SIZE);
     success = eeprom_load();
     make_configuration_portal();
     initialized = true;
@@ -27,6 +27,7 @@ const int USER_PARAM_MAX_LENGTH = 32;
 const int CONFIG_PORTAL_HTML_LENGTH = 4096;
 const byte DNS_PORT = 53;
 const unsigned int EEPROM_ADDRESS = 0;
+const unsigned int EEPROM_SIZE = 1024;      // EEPROM bytes reserved by init(), shared with other modules
 const char VALIDATION_STRING[8] = "xyz123";
 
 struct WifiConfig {
@@ -38,6 +39,9 @@ struct WifiConfig {
     char iot_port[8];
 };
 
+// First EEPROM address free for other modules (calibrations, etc.)
+const unsigned int EEPROM_USER_ADDRESS = EEPROM_ADDRESS + sizeof(WifiConfig);
+
 enum class WifiStatus {
     Idle = 0,
     Connected,
@@ -8,8 +8,18 @@ extern "C" {
 
 #include <WifiManager.h>
 #include <OSCManager.h>
+#include <UDPQueue.h>
 #include <LEDPin.h>
+#include <Timebase.h>
+#include <Dither.h>
 #include <Envelope.h>
+#include <ParamMailbox.h>
+#include <Gate.h>
+#include <Scheduler.h>
+
+/* Pin for the local gate input (3.3V logic); while bound, its edges gate the ADSR on
+ * the sample they arrive, without waiting for the network */
+#define GATE_PIN D2
 
 /* This pointer can point at the serial port if we're developing and debugging, or
  * NULL if we're done working and want to deploy without wasting time printing */
@@ -20,15 +30,40 @@ Stream *debug = NULL;     // Use this for deployment
 LEDPin wifi_led(LED_BUILTIN, 20);     // WiFi Status and UDP/TCP I/O Indicator LED
 WifiManager wifi(LED_BUILTIN, debug); // WiFi Manager
 OSCManager osc(debug);                // Open Sound Control Manager
+uint8_t loop_buffer[OSC_LOOP_BUFFER_LEN];  // Looper memory (4KB)
+uint8_t playout_buffer[OSC_PLAYOUT_BUFFER_LEN];  // Delayed bundle messages (1KB)
+UDPQueue udp_queue;                   // Receives UDP packets as lwIP delivers them
 
 /* Sample timer; calls the audio render callback function at a specified rate */
 ETSTimer sample_timer;                          // Sensor sample timer
-const float sample_rate = 16000;                // Sensor sample rate (Hz)
-const float sample_period = 1e6 / sample_rate;  // Sensor sample period (microseconds)
+Timebase timebase(16000);                       // Sensor sample rate (Hz) and time conversions
 
 // 8-bit ADSR envelope generator, outputs (0-255)
 ADSR8 adsr;
 
+/* Gate input: the pin is sampled every render tick into a Gate (edge detection with
+ * hysteresis, on a 0-1023 scale like analogRead) */
+Gate gate_in(0, 1023, EEPROM_USER_ADDRESS, debug);
+
+/* Error-feedback dither; writes the generator's fractional bits to the 8-bit sigma
+ * delta channel over time, so the filtered CV has finer steps than 8 bits */
+Dither8 dither;
+
+/* Continuous parameters are posted here by the OSC handlers; only the newest value
+ * of each is applied to the ADSR, at most once per control period (5ms) */
+enum {
+  ParamAttack = 0,
+  ParamDecay,
+  ParamSustain,
+  ParamRelease,
+  NumParams
+};
+ParamMailbox<NumParams> params;
+
+/* Cooperative scheduler for the main loop; runs WiFi maintenance, OSC (which reads
+ * packets until its 2ms budget is spent), the mailbox and the LED by priority */
+Scheduler scheduler;
+
 // Main Setup
 // ==========
 void setup() {
@@ -36,6 +71,10 @@ void setup() {
   if (debug) 
     Serial.begin(115200);
   pinMode(LED_BUILTIN, OUTPUT);
+  pinMode(GATE_PIN, INPUT);
+
+  // Receive OSC through the queue (before the port is opened on connection)
+  osc.set_queue(&udp_queue);
 
   // Set callback function for successful connection
   wifi.set_connect_handler(wifi_connected, NULL);
@@ -44,19 +83,42 @@ void setup() {
   if (!wifi.init() || !wifi.connect()) 
       wifi.open_access_point();
 
+  // Gate input (EEPROM is started by wifi.init()); unbound until /gatein 1, since
+  // an unconnected D2 floats (GPIO4 has no pull-down) and would gate at random
+  gate_in.init();
+
+  // Looper; replays only the handlers dispatched as loopable (true) below
+  osc.set_loop_buffer(loop_buffer, sizeof(loop_buffer));
+  osc.set_playout_buffer(playout_buffer, sizeof(playout_buffer));
+
   // Configure OSC Handlers
+  osc.dispatch_fast("/gate", osc_handle_gate, true);   // Handled as soon as it arrives
   osc.dispatch("/ping", osc_handle_ping);
   osc.dispatch("/config", osc_handle_config);
-  osc.dispatch("/attack", osc_handle_attack);
-  osc.dispatch("/decay", osc_handle_decay);
-  osc.dispatch("/sustain", osc_handle_sustain);
-  osc.dispatch("/release", osc_handle_release);
-  osc.dispatch("/gate", osc_handle_gate);
-  osc.dispatch("/retrigger", osc_handle_retrigger);
+  osc.dispatch("/attack", osc_handle_attack, true);
+  osc.dispatch("/decay", osc_handle_decay, true);
+  osc.dispatch("/sustain", osc_handle_sustain, true);
+  osc.dispatch("/release", osc_handle_release, true);
+  osc.dispatch("/retrigger", osc_handle_retrigger, true);
+  osc.dispatch("/curve", osc_handle_curve, true);
+  osc.dispatch("/gatein", osc_handle_gatein);
+  osc.dispatch("/playout", osc_handle_playout);
+  osc.dispatch("/jitter", osc_handle_jitter);
+  osc.dispatch("/tasks", osc_handle_tasks);
+
+  // Main loop tasks: name, function, userdata, priority, budget (us), period (ms)
+  scheduler.add_task("wifi", task_wifi, NULL, 3, 500);
+  scheduler.add_task("osc", task_osc, NULL, 2, 2000);
+  scheduler.add_task("params", task_params, NULL, 1, 500);
+  scheduler.add_task("led", task_led, NULL, 0, 50, 5);
 
   // ADSR setup
   adsr.set_eod_handler(end_of_decay, NULL);     // Callback function for end of decay
   adsr.set_eor_handler(end_of_release, NULL);   // Callback function for end of release
+  params.attach(ParamAttack, set_attack, NULL); // Setters for mailbox parameters
+  params.attach(ParamDecay, set_decay, NULL);
+  params.attach(ParamSustain, set_sustain, NULL);
+  params.attach(ParamRelease, set_release, NULL);
 
   // Sigma delta setup
   sigmaDeltaEnable();
@@ -67,16 +129,39 @@ void setup() {
   // Sensor sampling timer setup
   system_timer_reinit();
   ets_timer_setfn(&sample_timer, render, NULL);
-  ets_timer_arm_new(&sample_timer, sample_period, true, 0); 
+  ets_timer_arm_new(&sample_timer, timebase.sample_period_us(), true, 0); 
 }
 
 // Main Loop
 // =========
 void loop() {
+  scheduler.loop();     // Runs the tasks below
+}
+
+// Main Loop Tasks:
+// ================
+/* These functions get called by the scheduler with their time budget; each returns
+ * true if it did any work
+ */
+bool task_wifi(uint32_t budget_us, void *userdata) {
   wifi.loop();          // Maintains WiFi connection
-  if (osc.loop())       // Parses any incoming UDP packets
-    wifi_led.blink();   // Blink the LED if we handled an OSC message
+  return false;
+}
+
+bool task_osc(uint32_t budget_us, void *userdata) {
+  if (!osc.loop(budget_us))   // Parses incoming UDP packets within the budget
+    return false;
+  wifi_led.blink();     // Blink the LED if we handled an OSC message
+  return true;
+}
+
+bool task_params(uint32_t budget_us, void *userdata) {
+  return params.loop(); // Applies the newest ADSR parameters
+}
+
+bool task_led(uint32_t budget_us, void *userdata) {
   wifi_led.loop();      // Turns the LED back on if we blinked it over 20ms ago
+  return false;
 }
 
 // CV Render Callback:
@@ -84,9 +169,13 @@ void loop() {
 /* This function is called by ETSTimer at our specified sample rate. We use it to
  * generate our PWM signals (usually with analogWrite() on other Arduinos, but for
  * the ESP8266 we need to use sigmaDeltaWrite() 
+ *
+ * The gate input is sampled first, so an edge reaches the ADSR on the same sample
  */
 void render(void *p_arg) {
-  sigmaDeltaWrite(0, adsr.render());   // Write CV to channel 0
+  gate_in.process(digitalRead(GATE_PIN) ? 1023 : 0);       // Gates the ADSR if bound
+  sigmaDeltaWrite(0, dither.process(adsr.render_fine()));   // Write CV to channel 0
+  osc.tick();                                               // Advances the looper/playout clock
 }
 
 // WiFi Connect Handler:
@@ -113,6 +202,27 @@ void end_of_release(void *userdata) {
   osc.send(msg);          
 }
 
+// ADSR Parameter Setters:
+// =======================
+/* These functions get called by the parameter mailbox with the newest value posted
+ * by the matching OSC handler
+ */
+void set_attack(float time_ms, void *userdata) {
+  adsr.set_attack(timebase.ms_to_samples(time_ms));
+}
+
+void set_decay(float time_ms, void *userdata) {
+  adsr.set_decay(timebase.ms_to_samples(time_ms));
+}
+
+void set_sustain(float level, void *userdata) {
+  adsr.set_sustain((uint16_t)level);
+}
+
+void set_release(float time_ms, void *userdata) {
+  adsr.set_release(timebase.ms_to_samples(time_ms));
+}
+
 // OSC Handlers:
 // ============
 /* 
@@ -159,7 +269,7 @@ void osc_handle_attack(OSCMessage &msg) {
   else if (msg.isFloat(0))
     time_ms = msg.getFloat(0);
   else return;
-  adsr.set_attack((uint32_t)(time_ms/1000.0 * sample_rate));
+  params.post(ParamAttack, time_ms);
 }
 
 /* 
@@ -174,7 +284,7 @@ void osc_handle_decay(OSCMessage &msg) {
   else if (msg.isFloat(0))
     time_ms = msg.getFloat(0);
   else return;
-  adsr.set_decay((uint32_t)(time_ms/1000.0 * sample_rate));
+  params.post(ParamDecay, time_ms);
 }
 
 /* 
@@ -189,7 +299,7 @@ void osc_handle_sustain(OSCMessage &msg) {
   else if (msg.isFloat(0))
     level = (uint8_t)round(msg.getFloat(0));
   else return;
-  adsr.set_sustain(level);
+  params.post(ParamSustain, level);
 }
 
 /* 
@@ -204,7 +314,7 @@ void osc_handle_release(OSCMessage &msg) {
   else if (msg.isFloat(0))
     time_ms = msg.getFloat(0);
   else return;
-  adsr.set_release((uint32_t)(time_ms/1000.0 * sample_rate));
+  params.post(ParamRelease, time_ms);
 }
 
 /* 
@@ -213,8 +323,10 @@ void osc_handle_release(OSCMessage &msg) {
  * Gate the ADSR on (value != 0) or off (value == 0)
  */
 void osc_handle_gate(OSCMessage &msg) {
-  if (msg.isInt(0)) 
+  if (msg.isInt(0)) {
+    params.flush();   // Apply parameters received before the gate first
     adsr.gate(msg.getInt(0) != 0);
+  }
 }
 
 /* 
@@ -227,3 +339,85 @@ void osc_handle_retrigger(OSCMessage &msg) {
     adsr.set_retrigger(msg.getInt(0) != 0);
 }
 
+/*
+ * /curve <int> <int> <int>
+ *
+ * Set the attack, decay and release curvature [-8-8]: 0 is linear, positive curves
+ * move fast first (exponential, like an analog envelope), negative ones slow first
+ */
+void osc_handle_curve(OSCMessage &msg) {
+  if (msg.isInt(0) && msg.isInt(1) && msg.isInt(2)) {
+    adsr.set_attack_curve(msg.getInt(0));
+    adsr.set_decay_curve(msg.getInt(1));
+    adsr.set_release_curve(msg.getInt(2));
+  }
+}
+
+/* 
+ * /gatein <int>
+ * 
+ * Bind the gate input to the ADSR (value != 0) or ignore it (value == 0)
+ */
+void osc_handle_gatein(OSCMessage &msg) {
+  if (msg.isInt(0)) {
+    if (msg.getInt(0) != 0)
+      gate_in.bind_gate(adsr);
+    else
+      gate_in.set_edge_handler(NULL, NULL);
+  }
+}
+
+/* 
+ * /playout <int> [<int/float>]
+ * 
+ * Play time-tagged bundles at their sender's timing (value != 0) or as they arrive
+ * (value == 0), with an optional fixed delay in miliseconds (0 or none adapts the
+ * delay to the network jitter)
+ */
+void osc_handle_playout(OSCMessage &msg) {
+  float delay_ms = 0;
+  if (!msg.isInt(0))
+    return;
+  if (msg.isInt(1))
+    delay_ms = msg.getInt(1);
+  else if (msg.isFloat(1))
+    delay_ms = msg.getFloat(1);
+  osc.set_playout(msg.getInt(0) != 0, timebase.sample_rate());
+  osc.set_playout_delay(delay_ms * timebase.sample_rate() / 1000);
+}
+
+/* 
+ * /jitter
+ * 
+ * Responds with /jitter <jitter ms> <playout delay ms> <late> <overflows>
+ */
+void osc_handle_jitter(OSCMessage &msg) {
+  OSCMessage response("/jitter");
+  response.add(osc.jitter() * 1000.0f / timebase.sample_rate());
+  response.add(osc.playout_delay() * 1000.0f / timebase.sample_rate());
+  response.add((int32_t)osc.get_stats().late);
+  response.add((int32_t)osc.get_stats().overflows);
+  osc.set_dest(osc.remote_addr(), wifi.get_iot_port());
+  osc.send(response);
+}
+
+/*
+ * /tasks
+ *
+ * Responds with /tasks followed by <name> <runs> <busy> <overruns> <max us> for each
+ * main loop task (wifi, osc, params, led), counted since the previous /tasks
+ */
+void osc_handle_tasks(OSCMessage &msg) {
+  OSCMessage response("/tasks");
+  for (int i = 0; i < scheduler.num_tasks(); i++) {
+    const SchedStats &stats = scheduler.get_stats(i);
+    response.add(scheduler.get_name(i));
+    response.add((int32_t)stats.runs);
+    response.add((int32_t)stats.busy);
+    response.add((int32_t)stats.overruns);
+    response.add((int32_t)stats.max_us);
+  }
+  scheduler.reset_stats();
+  osc.set_dest(osc.remote_addr(), wifi.get_iot_port());
+  osc.send(response);
+}
@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+"""
+reliable_gate.py
+
+Sends /gate messages to devices running the ADSR example in sequence-numbered
+bundles, repeating each one a few times a few ms apart. The device handles only
+the first copy of each number, so a lost packet no longer leaves the envelope
+stuck in sustain and the repeats don't retrigger it.
+
+    python3 reliable_gate.py 192.168.1.20 --port 8000 --copies 3 --spacing 5
+
+Each line read from stdin is sent as /gate <int> (e.g. 1 or 0); sequence
+numbers start at the current time in ms, so a restarted sender isn't mistaken
+for repeats.
+"""
+import argparse
+import socket
+import struct
+import sys
+import time
+
+
+def osc_pad(b):
+    return b + b'\0' * (4 - len(b) % 4)
+
+
+def osc_message(path, *args):
+    tags = ',' + 'i' * len(args)
+    data = b''.join(struct.pack('>i', a) for a in args)
+    return osc_pad(path.encode()) + osc_pad(tags.encode()) + data
+
+
+def osc_bundle(*messages):
+    """Bundle with the time tag 'immediately'"""
+    data = osc_pad(b'#bundle') + struct.pack('>Q', 1)
+    for m in messages:
+        data += struct.pack('>i', len(m)) + m
+    return data
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('devices', nargs='+', help='device IP addresses')
+    parser.add_argument('--port', type=int, default=8000, help='IoT port (default 8000)')
+    parser.add_argument('--copies', type=int, default=3, help='copies of each event')
+    parser.add_argument('--spacing', type=float, default=5.0, help='ms between copies')
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_BROADCAST, 1)
+    seq = int(time.time() * 1000) & 0x7FFFFFFF
+
+    for line in sys.stdin:
+        try:
+            state = int(line)
+        except ValueError:
+            continue
+        packet = osc_bundle(osc_message('/seq', seq), osc_message('/gate', state))
+        for k in range(args.copies):
+            if k:
+                time.sleep(args.spacing / 1000.0)
+            for ip in args.devices:
+                sock.sendto(packet, (ip, args.port))
+        seq = (seq + 1) & 0x7FFFFFFF
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,173 @@
+#include <OSCManager.h>
+
+/* This sketch doesn't connect to a network. It builds OSC packets in memory that
+ * resemble the traffic a node sees during a performance and feeds them through
+ * OSCManager's parse and dispatch path, printing results to the serial port. */
+Stream *report = &Serial;
+
+/* Handler counts to benchmark; OSCManager scans its handlers in order, so the
+ * matching handlers are registered last (worst case) after N-4 unused paths */
+const int handler_counts[] = {4, 8, 16, OSC_MAX_NUM_HANDLERS};
+const int num_handler_counts = sizeof(handler_counts) / sizeof(handler_counts[0]);
+
+/* Number of timed messages per traffic class */
+const int BENCH_ITERATIONS = 256;
+const int BENCH_SEQUENCE_ITERATIONS = 32;   // /sequence messages are much larger
+const int BENCH_SEQUENCE_ARGS = 512;
+
+// Packet arena
+// ============
+/* Print implementation that serializes OSC messages into a byte buffer */
+class BufferPrint : public Print {
+public:
+  BufferPrint(uint8_t *buff, size_t max_len) : buff(buff), max_len(max_len), len(0) {}
+  size_t write(uint8_t c) {
+    if (len >= max_len)
+      return 0;
+    buff[len++] = c;
+    return 1;
+  }
+  uint8_t *buff;
+  size_t max_len;
+  size_t len;
+};
+
+const int ARENA_SIZE = 4096;
+const int MAX_PACKETS = 8;
+
+uint8_t arena[ARENA_SIZE];
+int arena_len = 0;
+
+struct Packet {
+  const char *name;
+  uint8_t *bytes;
+  size_t len;
+  int iterations;
+};
+
+Packet packets[MAX_PACKETS];
+int num_packets = 0;
+
+void add_packet(const char *name, OSCMessage &msg, int iterations) {
+  BufferPrint out(arena + arena_len, ARENA_SIZE - arena_len);
+  msg.send(out);
+  packets[num_packets].name = name;
+  packets[num_packets].bytes = arena + arena_len;
+  packets[num_packets].len = out.len;
+  packets[num_packets].iterations = iterations;
+  num_packets++;
+  arena_len += out.len;
+}
+
+// Handlers
+// ========
+/* Handlers do no work except recording the lowest free heap seen while the
+ * decoded message is alive, which gives the heap cost of each message */
+volatile uint32_t handled = 0;
+uint32_t heap_min;
+
+void bench_handler(OSCMessage &msg) {
+  uint32_t heap = ESP.getFreeHeap();
+  if (heap < heap_min)
+    heap_min = heap;
+  handled++;
+}
+
+void register_handlers(OSCManager &osc, int n) {
+  char path[OSC_MAX_PATH_LENGTH];
+  for (int i = 0; i < n - 4; i++) {
+    sprintf(path, "/unused/%d", i);
+    osc.dispatch(path, bench_handler);
+  }
+  osc.dispatch("/ping", bench_handler);
+  osc.dispatch("/rate", bench_handler);
+  osc.dispatch("/gate", bench_handler);
+  osc.dispatch("/sequence", bench_handler);
+}
+
+// Statistics
+// ==========
+uint32_t latency[BENCH_ITERATIONS];
+
+int compare_u32(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a;
+  uint32_t y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+uint32_t percentile(uint32_t *sorted, int n, int pct) {
+  int idx = (n * pct) / 100;
+  return sorted[idx < n ? idx : n - 1];
+}
+
+/* Time n iterations of handle_buffer() on a packet and print a result row */
+void bench_packet(OSCManager &osc, Packet &p, int n_handlers) {
+
+  uint32_t mhz = ESP.getCpuFreqMHz();
+  uint32_t heap_before = ESP.getFreeHeap();
+  uint32_t total = 0;
+  heap_min = heap_before;
+  handled = 0;
+
+  for (int i = 0; i < p.iterations; i++) {
+    uint32_t t0 = ESP.getCycleCount();
+    osc.handle_buffer(p.bytes, p.len);
+    latency[i] = ESP.getCycleCount() - t0;
+    total += latency[i];
+    yield();
+  }
+  qsort(latency, p.iterations, sizeof(uint32_t), compare_u32);
+
+  report->printf("%-10s %4d %10lu %8lu %8lu %8lu %8lu %8lu\n",
+    p.name, n_handlers,
+    (unsigned long)((uint64_t)p.iterations * mhz * 1000000 / total),
+    (unsigned long)(percentile(latency, p.iterations, 50) / mhz),
+    (unsigned long)(percentile(latency, p.iterations, 90) / mhz),
+    (unsigned long)(percentile(latency, p.iterations, 99) / mhz),
+    (unsigned long)(latency[p.iterations - 1] / mhz),
+    (unsigned long)(handled ? heap_before - heap_min : 0));
+}
+
+// Main Setup
+// ==========
+void setup() {
+
+  Serial.begin(115200);
+  delay(1000);
+
+  // Build traffic
+  OSCMessage rate("/rate");
+  rate.add(2.5f);
+  add_packet("/rate", rate, BENCH_ITERATIONS);
+
+  OSCMessage gate("/gate");
+  gate.add(1);
+  add_packet("/gate", gate, BENCH_ITERATIONS);
+
+  OSCMessage noise("/lfo/2/dutycycle");   // Broadcast to other nodes; no handler
+  noise.add(0.25f);
+  add_packet("noise", noise, BENCH_ITERATIONS);
+
+  OSCMessage sequence("/sequence");
+  for (int i = 0; i < BENCH_SEQUENCE_ARGS; i++)
+    sequence.add(i & 0xFF);
+  add_packet("/sequence", sequence, BENCH_SEQUENCE_ITERATIONS);
+
+  // Run each traffic class against each handler count
+  report->printf("\n%-10s %4s %10s %8s %8s %8s %8s %8s\n",
+    "traffic", "hdlr", "msg/s", "p50(us)", "p90(us)", "p99(us)", "max(us)", "heap(B)");
+  for (int i = 0; i < num_handler_counts; i++) {
+    OSCManager *osc = new OSCManager(NULL);
+    register_handlers(*osc, handler_counts[i]);
+    for (int j = 0; j < num_packets; j++)
+      bench_packet(*osc, packets[j], handler_counts[i]);
+    delete osc;
+  }
+  report->println("done");
+}
+
+// Main Loop
+// =========
+void loop() {
+
+}
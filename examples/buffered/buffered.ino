@@ -0,0 +1,165 @@
+#include <WifiManager.h>
+#include <OSCManager.h>
+#include <LEDPin.h>
+#include <Timebase.h>
+#include <Oscillator.h>
+#include <Output.h>
+
+/* Uncomment to play through the I2S peripheral (16-bit, pins RX/GPIO3 data,
+ * D8/GPIO15 bit clock, D4/GPIO2 word select) instead of sigma delta on pin D1 */
+//#define USE_I2S_OUTPUT
+
+/* This pointer can point at the serial port if we're developing and debugging, or
+ * NULL if we're done working and want to deploy without wasting time printing */
+//Stream *debug = &Serial;  // Use this for development
+Stream *debug = NULL;     // Use this for deployment
+
+/* Back-end classes that do all the heavy lifting */
+LEDPin wifi_led(LED_BUILTIN, 20);     // WiFi Status and UDP/TCP I/O Indicator LED
+WifiManager wifi(LED_BUILTIN, debug); // WiFi Manager
+OSCManager osc(debug);                // Open Sound Control Manager
+
+/* Output backend; the LFO is rendered in blocks from loop() into the output's ring
+ * buffer, up to 512 samples (32ms) ahead of playback */
+#ifdef USE_I2S_OUTPUT
+I2SOutput output;
+#else
+SigmaDeltaOutput output(D1, 0);       // Pin D1 on channel 0
+#endif
+Timebase timebase(16000);             // Sample rate (Hz) and time conversions
+
+// LFO, outputs (0-255)
+LFO8 lfo;
+
+// Main Setup
+// ==========
+void setup() {
+
+  if (debug)
+    Serial.begin(115200);
+  pinMode(LED_BUILTIN, OUTPUT);
+
+  // Set callback function for successful connection
+  wifi.set_connect_handler(wifi_connected, NULL);
+
+  // Initilize and connect WiFi or open access point if we fail to connect
+  if (!wifi.init() || !wifi.connect())
+      wifi.open_access_point();
+
+  // Configure OSC Handlers
+  osc.dispatch("/ping", osc_handle_ping);
+  osc.dispatch("/config", osc_handle_config);
+  osc.dispatch("/rate", osc_handle_rate);
+  osc.dispatch("/dutycycle", osc_handle_dutycycle);
+  osc.dispatch("/underruns", osc_handle_underruns);
+
+  // LFO setup
+  lfo.set_rate(UQ16x16(0.1), timebase);
+  lfo.set_duty_cycle(0.5);
+
+  // Output setup; fill the buffer before starting playback
+  output.set_render_handler(render, NULL);
+  output.loop();
+  output.begin(timebase.sample_rate());
+}
+
+// Main Loop
+// =========
+void loop() {
+  wifi.loop();          // Maintains WiFi connection
+  if (osc.loop())       // Parses any incoming UDP packets
+    wifi_led.blink();   // Blink the LED if we handled an OSC message
+  output.loop();        // Renders blocks into the output buffer
+  wifi_led.loop();      // Turns the LED back on if we blinked it over 20ms ago
+}
+
+// CV Render Callback:
+// ===================
+/* This function is called by the output from loop() whenever its buffer has room
+ * for a block of n samples
+ */
+void render(uint16_t *block, uint16_t n, void *userdata) {
+  for (int i = 0; i < n; i++)
+    block[i] = lfo.render();
+}
+
+// WiFi Connect Handler:
+// =====================
+/* This function is called by WifiManager when it successfully connects to a network.
+ * We use it to open a UDP port with the number specified in the WiFi config settings.
+ */
+void wifi_connected(void *userdata) {
+  osc.open_port(wifi.get_iot_port());
+}
+
+// OSC Handlers:
+// ============
+/*
+ * /ping
+ *
+ * This function responds to a /ping message with this IoT device's device ID, node ID,
+ * and IP address. We also 'connect' this device's UDP client to the IP address that
+ * sent the /ping, so that any OSC messages sent from this device are sent to that
+ * address on the IoT port
+ */
+void osc_handle_ping(OSCMessage &msg) {
+  // Make the response message
+  OSCMessage response("/pong");
+  char buff[32];
+  wifi.get_dev_id(buff);
+  response.add(buff);
+  wifi.get_node_id(buff);
+  response.add(buff);
+  response.add(wifi.get_local_address().toString().c_str());
+  // Set the /ping sender's IP as the destination address
+  osc.set_dest(osc.remote_addr(), wifi.get_iot_port());
+  // Send the response
+  osc.send(response);
+}
+
+/*
+ * /config
+ *
+ * Open access point to configure network settings and device/node identifiers
+ */
+void osc_handle_config(OSCMessage &msg) {
+  wifi.open_access_point();
+}
+
+/*
+ * /rate <int/float>
+ *
+ * Set rate in Hz
+ */
+void osc_handle_rate(OSCMessage &msg) {
+  UQ16x16 rate;
+  if (msg.isInt(0))
+    rate = msg.getInt(0);
+  else if (msg.isFloat(0))
+    rate = msg.getFloat(0);
+  else return;
+  lfo.set_rate(rate, timebase);
+}
+
+/*
+ * /dutycycle <float>
+ *
+ * Set duty cycle [0-1]
+ */
+void osc_handle_dutycycle(OSCMessage &msg) {
+  if (msg.isFloat(0))
+    lfo.set_duty_cycle(msg.getFloat(0));
+}
+
+/*
+ * /underruns
+ *
+ * Responds with /underruns <int>, the number of samples the output needed while
+ * its buffer was empty
+ */
+void osc_handle_underruns(OSCMessage &msg) {
+  OSCMessage response("/underruns");
+  response.add((int32_t)output.underruns());
+  osc.set_dest(osc.remote_addr(), wifi.get_iot_port());
+  osc.send(response);
+}
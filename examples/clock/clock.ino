@@ -0,0 +1,222 @@
+#define USE_US_TIMER    // Necessary for enabling ETSTimer's microsecond accuracy
+
+extern "C" {
+#include "user_interface.h"
+#include "ets_sys.h"
+#include "sigma_delta.h"
+}
+
+#include <WifiManager.h>
+#include <OSCManager.h>
+#include <LEDPin.h>
+#include <Timebase.h>
+#include <Gate.h>
+#include <ClockTracker.h>
+#include <Sequencer.h>
+
+/* Pin for the external clock input (3.3V logic; use a divider or transistor for
+ * modular-level clocks) */
+#define CLOCK_PIN D2
+
+/* This pointer can point at the serial port if we're developing and debugging, or
+ * NULL if we're done working and want to deploy without wasting time printing */
+//Stream *debug = &Serial;  // Use this for development
+Stream *debug = NULL;     // Use this for deployment
+
+/* Back-end classes that do all the heavy lifting */
+LEDPin wifi_led(LED_BUILTIN, 20);     // WiFi Status and UDP/TCP I/O Indicator LED
+WifiManager wifi(LED_BUILTIN, debug); // WiFi Manager
+OSCManager osc(debug);                // Open Sound Control Manager
+
+/* Sample timer; calls the audio render callback function at a specified rate */
+ETSTimer sample_timer;                          // Sensor sample timer
+Timebase timebase(16000);                       // Sensor sample rate (Hz) and time conversions
+
+/* Clock input: the pin is sampled every render tick into a Gate (edge detection
+ * with hysteresis, on a 0-1023 scale like analogRead), whose rising edges drive
+ * the clock tracker */
+Gate clock_in(0, 1023, EEPROM_USER_ADDRESS, debug);
+ClockTracker clock_tracker;
+
+// 8-bit sequencer, outputs (0-255); steps on the tracked clock
+SEQ8 seq;
+
+// Main Setup
+// ==========
+void setup() {
+
+  if (debug)
+    Serial.begin(115200);
+  pinMode(LED_BUILTIN, OUTPUT);
+  pinMode(CLOCK_PIN, INPUT);
+
+  // Set callback function for successful connection
+  wifi.set_connect_handler(wifi_connected, NULL);
+
+  // Initilize and connect WiFi or open access point if we fail to connect
+  if (!wifi.init() || !wifi.connect())
+      wifi.open_access_point();
+
+  // Clock input (EEPROM is started by wifi.init())
+  clock_in.init();
+
+  // Configure OSC Handlers
+  osc.dispatch("/ping", osc_handle_ping);
+  osc.dispatch("/config", osc_handle_config);
+  osc.dispatch("/sequence", osc_handle_sequence);
+  osc.dispatch("/glidetime", osc_handle_glidetime);
+  osc.dispatch("/ratio", osc_handle_ratio);
+  osc.dispatch("/gate", osc_handle_gate);
+  osc.dispatch("/clock", osc_handle_clock);
+
+  // Sequencer setup
+  seq.set_external_clock(true);
+  uint8_t val = 31;
+  for (int i = 0; i < 8; i++) {
+    seq.append_step(val);
+    val += 32;
+  }
+  seq.gate(true);
+
+  // Sigma delta setup
+  sigmaDeltaEnable();
+  sigmaDeltaSetup(0, 240000);   // Set up channel 0 at PWM freq. of 240,000Hz
+  sigmaDeltaAttachPin(D1, 0);   // Use pin D1 on channel 0
+  // Note: sigma delta on ESP8266 is limited to 8 bits (0-255)
+
+  // Sensor sampling timer setup
+  system_timer_reinit();
+  ets_timer_setfn(&sample_timer, render, NULL);
+  ets_timer_arm_new(&sample_timer, timebase.sample_period_us(), true, 0);
+}
+
+// Main Loop
+// =========
+void loop() {
+  wifi.loop();          // Maintains WiFi connection
+  if (osc.loop())       // Parses any incoming UDP packets
+    wifi_led.blink();   // Blink the LED if we handled an OSC message
+  wifi_led.loop();      // Turns the LED back on if we blinked it over 20ms ago
+}
+
+// CV Render Callback:
+// ===================
+/* This function is called by ETSTimer at our specified sample rate. The clock input
+ * is sampled, its edges update the tracker, and the sequencer steps on the tracker's
+ * multiplied/divided clock, all on the same sample
+ */
+void render(void *p_arg) {
+  if (clock_in.process(digitalRead(CLOCK_PIN) ? 1023 : 0) && clock_in.get_state())
+    clock_tracker.edge();
+  if (clock_tracker.tick())
+    seq.clock();
+  sigmaDeltaWrite(0, seq.render());   // Write CV to channel 0
+}
+
+// WiFi Connect Handler:
+// =====================
+/* This function is called by WifiManager when it successfully connects to a network.
+ * We use it to open a UDP port with the number specified in the WiFi config settings.
+ */
+void wifi_connected(void *userdata) {
+  osc.open_port(wifi.get_iot_port());
+}
+
+// OSC Handlers:
+// ============
+/*
+ * /ping
+ *
+ * This function responds to a /ping message with this IoT device's device ID, node ID,
+ * and IP address. We also 'connect' this device's UDP client to the IP address that
+ * sent the /ping, so that any OSC messages sent from this device are sent to that
+ * address on the IoT port
+ */
+void osc_handle_ping(OSCMessage &msg) {
+  // Make the response message
+  OSCMessage response("/pong");
+  char buff[32];
+  wifi.get_dev_id(buff);
+  response.add(buff);
+  wifi.get_node_id(buff);
+  response.add(buff);
+  response.add(wifi.get_local_address().toString().c_str());
+  // Set the /ping sender's IP as the destination address
+  osc.set_dest(osc.remote_addr(), wifi.get_iot_port());
+  // Send the response
+  osc.send(response);
+}
+
+/*
+ * /config
+ *
+ * Open access point to configure network settings and device/node identifiers
+ */
+void osc_handle_config(OSCMessage &msg) {
+  wifi.open_access_point();
+}
+
+/*
+ * /sequence <int/float> <int/float> ... <int/float>
+ *
+ * Set up to 512 sequencer steps [0-255]
+ */
+void osc_handle_sequence(OSCMessage &msg) {
+  seq.clear();
+  for (int i = 0; i < msg.size(); i++) {
+    if (msg.isInt(i))
+      seq.append_step(msg.getInt(i));
+    else if (msg.isFloat(i))
+      seq.append_step((uint8_t)msg.getFloat(i));
+  }
+}
+
+/*
+ * /glidetime <int/float>
+ *
+ * Set portamento time in miliseconds
+ */
+void osc_handle_glidetime(OSCMessage &msg) {
+  float time_ms;
+  if (msg.isInt(0))
+    time_ms = msg.getInt(0);
+  else if (msg.isFloat(0))
+    time_ms = msg.getFloat(0);
+  else return;
+  seq.set_glide_length(timebase.ms_to_samples(time_ms));
+}
+
+/*
+ * /ratio <int> <int>
+ *
+ * Step on the input clock multiplied by the first and divided by the second
+ * argument (e.g. 4 1 steps four times per input clock, 1 2 every other clock)
+ */
+void osc_handle_ratio(OSCMessage &msg) {
+  if (msg.isInt(0) && msg.isInt(1))
+    clock_tracker.set_ratio(msg.getInt(0), msg.getInt(1));
+}
+
+/*
+ * /gate <int>
+ *
+ * Turns the sequencer off (zero) or on (nonzero)
+ */
+void osc_handle_gate(OSCMessage &msg) {
+  if (msg.isInt(0))
+    seq.gate(msg.getInt(0) != 0);
+}
+
+/*
+ * /clock
+ *
+ * Responds with /clock <locked> <period ms>, whether the tracker is following a
+ * clock and its estimate of the input clock period
+ */
+void osc_handle_clock(OSCMessage &msg) {
+  OSCMessage response("/clock");
+  response.add((int32_t)clock_tracker.locked());
+  response.add((float)clock_tracker.period_q8() / 256.0f * 1000.0f / timebase.sample_rate());
+  osc.set_dest(osc.remote_addr(), wifi.get_iot_port());
+  osc.send(response);
+}
@@ -9,6 +9,7 @@ extern "C" {
 #include <WifiManager.h>
 #include <OSCManager.h>
 #include <LEDPin.h>
+#include <Timebase.h>
 
 /* This pointer can point at the serial port if we're developing and debugging, or
  * NULL if we're done working and want to deploy without wasting time printing */
@@ -22,8 +23,7 @@ OSCManager osc(debug);                // Open Sound Control Manager
 
 /* Sample timer; calls the audio render callback function at a specified rate */
 ETSTimer sample_timer;                          // Sensor sample timer
-const float sample_rate = 16000;                // Sensor sample rate (Hz)
-const float sample_period = 1e6 / sample_rate;  // Sensor sample period (microseconds)
+Timebase timebase(16000);                       // Sensor sample rate (Hz) and time conversions
 
 // 8-bit CV value (0-255)
 uint8_t cv = 127;
@@ -57,7 +57,7 @@ void setup() {
   // Sensor sampling timer setup
   system_timer_reinit();
   ets_timer_setfn(&sample_timer, render, NULL);
-  ets_timer_arm_new(&sample_timer, sample_period, true, 0); 
+  ets_timer_arm_new(&sample_timer, timebase.sample_period_us(), true, 0); 
 }
 
 // Main Loop:
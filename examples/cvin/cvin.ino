@@ -0,0 +1,212 @@
+#define USE_US_TIMER    // Necessary for enabling ETSTimer's microsecond accuracy
+
+extern "C" {
+#include "user_interface.h"
+#include "ets_sys.h"
+#include "sigma_delta.h"
+}
+
+#include <WifiManager.h>
+#include <OSCManager.h>
+#include <LEDPin.h>
+#include <Timebase.h>
+#include <Dither.h>
+#include <Envelope.h>
+#include <Gate.h>
+#include <AnalogInput.h>
+
+/* This pointer can point at the serial port if we're developing and debugging, or
+ * NULL if we're done working and want to deploy without wasting time printing */
+//Stream *debug = &Serial;  // Use this for development
+Stream *debug = NULL;     // Use this for deployment
+
+/* Back-end classes that do all the heavy lifting */
+LEDPin wifi_led(LED_BUILTIN, 20);     // WiFi Status and UDP/TCP I/O Indicator LED
+WifiManager wifi(LED_BUILTIN, debug); // WiFi Manager
+OSCManager osc(debug);                // Open Sound Control Manager
+
+/* Sample timer; calls the audio render callback function at a specified rate */
+ETSTimer sample_timer;                          // Sensor sample timer
+Timebase timebase(16000);                       // Sensor sample rate (Hz) and time conversions
+
+/* Analog input on A0: the ADC is read by its own timer at 4kHz, and each group of 4
+ * readings is filtered down to one sample (1kHz) in loop() */
+#define ADC_RATE 4000
+AnalogInput cv_in(4, AIN_BOXCAR);
+
+/* Gate fed with the filtered input; edge detection with hysteresis, calibrated on
+ * the ADC's 0-1023 scale */
+Gate gate_in(0, 1023, EEPROM_USER_ADDRESS, debug);
+
+// 8-bit ADSR envelope generator, outputs (0-255)
+ADSR8 adsr;
+
+/* Error-feedback dither; writes the generator's fractional bits to the 8-bit sigma
+ * delta channel over time */
+Dither8 dither;
+
+// Main Setup
+// ==========
+void setup() {
+
+  if (debug)
+    Serial.begin(115200);
+  pinMode(LED_BUILTIN, OUTPUT);
+
+  // Set callback function for successful connection
+  wifi.set_connect_handler(wifi_connected, NULL);
+
+  // Initilize and connect WiFi or open access point if we fail to connect
+  if (!wifi.init() || !wifi.connect())
+      wifi.open_access_point();
+
+  // Gate input (EEPROM is started by wifi.init()), bound to the ADSR's gate
+  gate_in.init();
+  gate_in.bind_gate(adsr);
+  cv_in.set_block_handler(input_block, NULL);
+
+  // Configure OSC Handlers
+  osc.dispatch("/ping", osc_handle_ping);
+  osc.dispatch("/config", osc_handle_config);
+  osc.dispatch("/input", osc_handle_input);
+  osc.dispatch("/filter", osc_handle_filter);
+  osc.dispatch("/calibrate/min", osc_handle_calibrate_min);
+  osc.dispatch("/calibrate/max", osc_handle_calibrate_max);
+
+  // ADSR setup
+  adsr.set_attack(UQ16x16(5), timebase);
+  adsr.set_decay(UQ16x16(200), timebase);
+  adsr.set_sustain(128);
+  adsr.set_release(UQ16x16(500), timebase);
+
+  // Sigma delta setup
+  sigmaDeltaEnable();
+  sigmaDeltaSetup(0, 240000);   // Set up channel 0 at PWM freq. of 240,000Hz
+  sigmaDeltaAttachPin(D1, 0);   // Use pin D1 on channel 0
+  // Note: sigma delta on ESP8266 is limited to 8 bits (0-255)
+
+  // Sensor sampling timer setup
+  system_timer_reinit();
+  ets_timer_setfn(&sample_timer, render, NULL);
+  ets_timer_arm_new(&sample_timer, timebase.sample_period_us(), true, 0);
+
+  // ADC sampling timer setup
+  cv_in.begin(ADC_RATE);
+}
+
+// Main Loop
+// =========
+void loop() {
+  wifi.loop();          // Maintains WiFi connection
+  cv_in.loop();         // Filters the ADC readings and passes them to the gate
+  if (osc.loop())       // Parses any incoming UDP packets
+    wifi_led.blink();   // Blink the LED if we handled an OSC message
+  wifi_led.loop();      // Turns the LED back on if we blinked it over 20ms ago
+}
+
+// CV Render Callback:
+// ===================
+/* This function is called by ETSTimer at our specified sample rate. We use it to
+ * generate our PWM signals (usually with analogWrite() on other Arduinos, but for
+ * the ESP8266 we need to use sigmaDeltaWrite()
+ */
+void render(void *p_arg) {
+  sigmaDeltaWrite(0, dither.process(adsr.render_fine()));   // Write CV to channel 0
+}
+
+// Analog Input Block Handler:
+// ===========================
+/* This function is called by AnalogInput from loop() with each block of filtered
+ * samples; the gate gates the ADSR on its edges
+ */
+void input_block(const uint16_t *x, uint16_t n, void *userdata) {
+  gate_in.process(x, n);
+}
+
+// WiFi Connect Handler:
+// =====================
+/* This function is called by WifiManager when it successfully connects to a network.
+ * We use it to open a UDP port with the number specified in the WiFi config settings.
+ */
+void wifi_connected(void *userdata) {
+  osc.open_port(wifi.get_iot_port());
+}
+
+// OSC Handlers:
+// ============
+/*
+ * /ping
+ *
+ * This function responds to a /ping message with this IoT device's device ID, node ID,
+ * and IP address. We also 'connect' this device's UDP client to the IP address that
+ * sent the /ping, so that any OSC messages sent from this device are sent to that
+ * address on the IoT port
+ */
+void osc_handle_ping(OSCMessage &msg) {
+  // Make the response message
+  OSCMessage response("/pong");
+  char buff[32];
+  wifi.get_dev_id(buff);
+  response.add(buff);
+  wifi.get_node_id(buff);
+  response.add(buff);
+  response.add(wifi.get_local_address().toString().c_str());
+  // Set the /ping sender's IP as the destination address
+  osc.set_dest(osc.remote_addr(), wifi.get_iot_port());
+  // Send the response
+  osc.send(response);
+}
+
+/*
+ * /config
+ *
+ * Open access point to configure network settings and device/node identifiers
+ */
+void osc_handle_config(OSCMessage &msg) {
+  wifi.open_access_point();
+}
+
+/*
+ * /input
+ *
+ * Responds with /input <level> <state> <overruns>: the latest filtered input [0-1023],
+ * the gate state, and the number of ADC readings dropped
+ */
+void osc_handle_input(OSCMessage &msg) {
+  OSCMessage response("/input");
+  response.add((int32_t)cv_in.value());
+  response.add((int32_t)gate_in.get_state());
+  response.add((int32_t)cv_in.overruns());
+  osc.set_dest(osc.remote_addr(), wifi.get_iot_port());
+  osc.send(response);
+}
+
+/*
+ * /filter <int> <int>
+ *
+ * Set the readings per filtered sample [1-16] and the filter: mean (0) or median (1)
+ */
+void osc_handle_filter(OSCMessage &msg) {
+  if (msg.isInt(0) && msg.isInt(1)) {
+    cv_in.set_decimation(msg.getInt(0));
+    cv_in.set_filter(msg.getInt(1));
+  }
+}
+
+/*
+ * /calibrate/min
+ *
+ * Take the current input as the gate's low level and store the calibration
+ */
+void osc_handle_calibrate_min(OSCMessage &msg) {
+  gate_in.calibrate_min();
+}
+
+/*
+ * /calibrate/max
+ *
+ * Take the current input as the gate's high level and store the calibration
+ */
+void osc_handle_calibrate_max(OSCMessage &msg) {
+  gate_in.calibrate_max();
+}
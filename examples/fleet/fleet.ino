@@ -0,0 +1,211 @@
+#define USE_US_TIMER    // Necessary for enabling ETSTimer's microsecond accuracy
+
+extern "C" {
+#include "user_interface.h"
+#include "ets_sys.h"
+#include "sigma_delta.h"
+}
+
+#include <WifiManager.h>
+#include <OSCManager.h>
+#include <LEDPin.h>
+#include <Timebase.h>
+#include <Oscillator.h>
+
+/* Number of virtual nodes hosted by this device. Each one listens on its own UDP
+ * port (IoT port + index) with its own OSCManager and LFO, so a handful of devices
+ * can stand in for a much larger fleet when driven by fleet_controller.py */
+#define FLEET_NUM_NODES 8
+
+/* This pointer can point at the serial port if we're developing and debugging, or
+ * NULL if we're done working and want to deploy without wasting time printing */
+//Stream *debug = &Serial;  // Use this for development
+Stream *debug = NULL;     // Use this for deployment
+
+/* Back-end classes that do all the heavy lifting */
+LEDPin wifi_led(LED_BUILTIN, 20);     // WiFi Status and UDP/TCP I/O Indicator LED
+WifiManager wifi(LED_BUILTIN, debug); // WiFi Manager
+
+/* Sample timer; calls the audio render callback function at a specified rate */
+ETSTimer sample_timer;                          // Sensor sample timer
+Timebase timebase(16000);                       // Sensor sample rate (Hz) and time conversions
+
+// Virtual node: identity, OSC manager and generator
+struct VirtualNode {
+  char node_id[NODE_ID_MAX_LENGTH + 4];   // <NodeID>.<index>
+  uint16_t port;                          // Listening port
+  OSCManager osc;                         // Open Sound Control Manager
+  LFO8 lfo;                               // 8-bit LFO, outputs (0-255)
+  volatile uint32_t render_cycles;        // CPU cycles spent rendering the LFO
+  uint32_t stats_time;                    // millis() at the last /stats reply
+};
+
+VirtualNode nodes[FLEET_NUM_NODES];
+VirtualNode *current = NULL;    // Node whose OSC handlers are being called
+
+// Main Setup
+// ==========
+void setup() {
+
+  if (debug)
+    Serial.begin(115200);
+  pinMode(LED_BUILTIN, OUTPUT);
+
+  // Set callback function for successful connection
+  wifi.set_connect_handler(wifi_connected, NULL);
+
+  // Initilize and connect WiFi or open access point if we fail to connect
+  if (!wifi.init() || !wifi.connect())
+      wifi.open_access_point();
+
+  // Configure OSC Handlers and LFOs for every virtual node
+  char node_id[NODE_ID_MAX_LENGTH];
+  wifi.get_node_id(node_id);
+  for (int i = 0; i < FLEET_NUM_NODES; i++) {
+    VirtualNode &node = nodes[i];
+    sprintf(node.node_id, "%s.%d", node_id, i);
+    node.osc.dispatch("/ping", osc_handle_ping);
+    node.osc.dispatch("/config", osc_handle_config);
+    node.osc.dispatch("/rate", osc_handle_rate);
+    node.osc.dispatch("/dutycycle", osc_handle_dutycycle);
+    node.osc.dispatch("/stats", osc_handle_stats);
+    node.lfo.set_rate(UQ16x16(0.1 * (i + 1)), timebase);
+    node.lfo.set_duty_cycle(0.5);
+    node.render_cycles = 0;
+    node.stats_time = millis();
+  }
+
+  // Sigma delta setup
+  sigmaDeltaEnable();
+  sigmaDeltaSetup(0, 240000);   // Set up channel 0 at PWM freq. of 240,000Hz
+  sigmaDeltaAttachPin(D1, 0);   // Use pin D1 on channel 0
+  // Note: sigma delta on ESP8266 is limited to 8 bits (0-255)
+
+  // Sensor sampling timer setup
+  system_timer_reinit();
+  ets_timer_setfn(&sample_timer, render, NULL);
+  ets_timer_arm_new(&sample_timer, timebase.sample_period_us(), true, 0);
+}
+
+// Main Loop
+// =========
+void loop() {
+  wifi.loop();                // Maintains WiFi connection
+  for (int i = 0; i < FLEET_NUM_NODES; i++) {
+    current = &nodes[i];
+    if (current->osc.loop())  // Parses any incoming UDP packets for this node
+      wifi_led.blink();       // Blink the LED if we handled an OSC message
+  }
+  wifi_led.loop();            // Turns the LED back on if we blinked it over 20ms ago
+}
+
+// CV Render Callback:
+// ===================
+/* This function is called by ETSTimer at our specified sample rate. Every virtual
+ * node's LFO is rendered (and timed); their average is written to channel 0
+ */
+void render(void *p_arg) {
+  uint16_t sum = 0;
+  for (int i = 0; i < FLEET_NUM_NODES; i++) {
+    uint32_t t0 = ESP.getCycleCount();
+    sum += nodes[i].lfo.render();
+    nodes[i].render_cycles += ESP.getCycleCount() - t0;
+  }
+  sigmaDeltaWrite(0, sum / FLEET_NUM_NODES);   // Write CV to channel 0
+}
+
+// WiFi Connect Handler:
+// =====================
+/* This function is called by WifiManager when it successfully connects to a network.
+ * Virtual node i listens on the IoT port + i.
+ */
+void wifi_connected(void *userdata) {
+  for (int i = 0; i < FLEET_NUM_NODES; i++) {
+    nodes[i].port = wifi.get_iot_port() + i;
+    nodes[i].osc.open_port(nodes[i].port);
+  }
+}
+
+// OSC Handlers:
+// ============
+/*
+ * /ping [<int>]
+ *
+ * Responds with /pong <deviceID> <nodeID>.<index> <IPAddress> <port>, followed by
+ * the optional integer token sent with the /ping so the sender can match replies
+ * and measure round-trip time. Replies go to the sender's IP on the IoT port.
+ */
+void osc_handle_ping(OSCMessage &msg) {
+  OSCMessage response("/pong");
+  char buff[32];
+  wifi.get_dev_id(buff);
+  response.add(buff);
+  response.add(current->node_id);
+  response.add(wifi.get_local_address().toString().c_str());
+  response.add((int32_t)current->port);
+  if (msg.isInt(0))
+    response.add(msg.getInt(0));
+  current->osc.set_dest(current->osc.remote_addr(), wifi.get_iot_port());
+  current->osc.send(response);
+}
+
+/*
+ * /config
+ *
+ * Open access point to configure network settings and device/node identifiers
+ */
+void osc_handle_config(OSCMessage &msg) {
+  wifi.open_access_point();
+}
+
+/*
+ * /rate <int/float>
+ *
+ * Set rate in Hz
+ */
+void osc_handle_rate(OSCMessage &msg) {
+  UQ16x16 rate;
+  if (msg.isInt(0))
+    rate = msg.getInt(0);
+  else if (msg.isFloat(0))
+    rate = msg.getFloat(0);
+  else return;
+  current->lfo.set_rate(rate, timebase);
+}
+
+/*
+ * /dutycycle <float>
+ *
+ * Set duty cycle [0-1]
+ */
+void osc_handle_dutycycle(OSCMessage &msg) {
+  if (msg.isFloat(0))
+    current->lfo.set_duty_cycle(msg.getFloat(0));
+}
+
+/*
+ * /stats
+ *
+ * Responds with /stats <nodeID>.<index> <packets> <handled> <unmatched> <errors>
+ * <osc cycles> <render cycles> <elapsed ms> <cpu MHz>, counted since the previous
+ * /stats, then resets the counters (the /stats packet is counted in the next interval).
+ */
+void osc_handle_stats(OSCMessage &msg) {
+  const OSCStats &stats = current->osc.get_stats();
+  uint32_t now = millis();
+  OSCMessage response("/stats");
+  response.add(current->node_id);
+  response.add((int32_t)stats.packets);
+  response.add((int32_t)stats.handled);
+  response.add((int32_t)stats.unmatched);
+  response.add((int32_t)stats.errors);
+  response.add((int32_t)stats.cycles);
+  response.add((int32_t)current->render_cycles);
+  response.add((int32_t)(now - current->stats_time));
+  response.add((int32_t)ESP.getCpuFreqMHz());
+  current->osc.set_dest(current->osc.remote_addr(), wifi.get_iot_port());
+  current->osc.send(response);
+  current->osc.reset_stats();
+  current->render_cycles = 0;
+  current->stats_time = now;
+}
@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+"""
+fleet_controller.py
+
+Drives devices running the fleet example and reports delivery rate, /ping
+round-trip time and CPU load per virtual node as the fleet grows.
+
+    python3 fleet_controller.py 192.168.1.20 192.168.1.21 --sizes 1,2,4,8,16
+
+Each device hosts NODES virtual nodes on ports PORT..PORT+NODES-1; replies are
+received on PORT, so run this on the machine configured as the OSC destination.
+"""
+import argparse
+import socket
+import struct
+import time
+
+
+def osc_pad(b):
+    return b + b'\0' * (4 - len(b) % 4)
+
+
+def osc_encode(path, *args):
+    tags = ','
+    data = b''
+    for a in args:
+        if isinstance(a, int):
+            tags += 'i'
+            data += struct.pack('>i', a)
+        elif isinstance(a, float):
+            tags += 'f'
+            data += struct.pack('>f', a)
+        else:
+            tags += 's'
+            data += osc_pad(a.encode())
+    return osc_pad(path.encode()) + osc_pad(tags.encode()) + data
+
+
+def osc_decode(packet):
+    def string(i):
+        end = packet.index(b'\0', i)
+        return packet[i:end].decode(), (end + 4) & ~3
+    path, i = string(0)
+    tags, i = string(i)
+    args = []
+    for t in tags[1:]:
+        if t == 'i':
+            args.append(struct.unpack('>i', packet[i:i + 4])[0])
+            i += 4
+        elif t == 'f':
+            args.append(struct.unpack('>f', packet[i:i + 4])[0])
+            i += 4
+        elif t == 's':
+            s, i = string(i)
+            args.append(s)
+    return path, args
+
+
+def receive(sock, timeout):
+    """Collect replies until nothing arrives for `timeout` seconds"""
+    replies = []
+    sock.settimeout(timeout)
+    while True:
+        try:
+            packet, _ = sock.recvfrom(4096)
+        except socket.timeout:
+            return replies
+        replies.append((time.monotonic(), osc_decode(packet)))
+
+
+def run(sock, nodes, args):
+    """Run one round against the given (ip, port) virtual nodes"""
+    # Reset counters
+    for addr in nodes:
+        sock.sendto(osc_encode('/stats'), addr)
+    receive(sock, 0.2)
+
+    # Stream /rate messages to every node at the requested pace
+    interval = 1.0 / args.rate
+    for k in range(args.messages):
+        for addr in nodes:
+            sock.sendto(osc_encode('/rate', 0.1 + 0.01 * (k % 100)), addr)
+        time.sleep(interval)
+
+    # Ping every node with a token and match the /pong replies
+    sent = {}
+    for token, addr in enumerate(nodes):
+        sent[token] = time.monotonic()
+        sock.sendto(osc_encode('/ping', token), addr)
+    rtt = {}
+    for t, (path, reply) in receive(sock, 0.5):
+        if path == '/pong' and len(reply) > 4 and reply[4] in sent:
+            rtt[reply[1]] = (t - sent[reply[4]]) * 1000.0
+
+    # Gather counters
+    for addr in nodes:
+        sock.sendto(osc_encode('/stats'), addr)
+    stats = {}
+    for _, (path, reply) in receive(sock, 0.5):
+        if path == '/stats':
+            stats[reply[0]] = reply[1:]
+
+    expected = args.messages + 2    # Resetting /stats, /rate stream and /ping
+    print('\nfleet size %d: %d/%d nodes answered /stats, %d/%d answered /ping'
+          % (len(nodes), len(stats), len(nodes), len(rtt), len(nodes)))
+    print('%-12s %9s %9s %9s %9s' % ('node', 'delivery', 'rtt(ms)', 'osc(%)', 'render(%)'))
+    for node_id in sorted(stats):
+        packets, handled, unmatched, errors, osc_cyc, rnd_cyc, ms, mhz = stats[node_id]
+        budget = max(ms, 1) * mhz * 1000.0
+        print('%-12s %8.1f%% %9s %9.2f %9.2f' % (
+            node_id, 100.0 * handled / expected,
+            '%.1f' % rtt[node_id] if node_id in rtt else '-',
+            100.0 * (osc_cyc & 0xFFFFFFFF) / budget,
+            100.0 * (rnd_cyc & 0xFFFFFFFF) / budget))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('devices', nargs='+', help='device IP addresses')
+    parser.add_argument('--port', type=int, default=8000, help='IoT port (default 8000)')
+    parser.add_argument('--nodes', type=int, default=8, help='virtual nodes per device')
+    parser.add_argument('--sizes', default='1,2,4,8,16,32,64,128,256',
+        help='comma-separated fleet sizes to test')
+    parser.add_argument('--messages', type=int, default=100, help='/rate messages per node')
+    parser.add_argument('--rate', type=float, default=100.0, help='/rate messages per second')
+    args = parser.parse_args()
+
+    fleet = [(ip, args.port + i) for ip in args.devices for i in range(args.nodes)]
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(('', args.port))
+
+    for size in [int(n) for n in args.sizes.split(',')]:
+        if size > len(fleet):
+            print('\nfleet size %d: only %d virtual nodes available' % (size, len(fleet)))
+            break
+        run(sock, fleet[:size], args)
+
+
+if __name__ == '__main__':
+    main()
@@ -9,7 +9,10 @@ extern "C" {
 #include <WifiManager.h>
 #include <OSCManager.h>
 #include <LEDPin.h>
+#include <Timebase.h>
+#include <Dither.h>
 #include <Oscillator.h>
+#include <ParamMailbox.h>
 
 /* This pointer can point at the serial port if we're developing and debugging, or
  * NULL if we're done working and want to deploy without wasting time printing */
@@ -23,12 +26,24 @@ OSCManager osc(debug);                // Open Sound Control Manager
 
 /* Sample timer; calls the audio render callback function at a specified rate */
 ETSTimer sample_timer;                          // Sensor sample timer
-const float sample_rate = 16000;                // Sensor sample rate (Hz)
-const float sample_period = 1e6 / sample_rate;  // Sensor sample period (microseconds)
+Timebase timebase(16000);                       // Sensor sample rate (Hz) and time conversions
 
 // 8-bit LFO, outputs (0-255)
 LFO8 lfo;
 
+/* Error-feedback dither; writes the generator's fractional bits to the 8-bit sigma
+ * delta channel over time, so the filtered CV has finer steps than 8 bits */
+Dither8 dither;
+
+/* Continuous parameters are posted here by the OSC handlers; only the newest value
+ * of each is applied to the LFO, at most once per control period (5ms) */
+enum {
+  ParamRate = 0,
+  ParamDutyCycle,
+  NumParams
+};
+ParamMailbox<NumParams> params;
+
 // Main Setup
 // ==========
 void setup() {
@@ -49,10 +64,13 @@ void setup() {
   osc.dispatch("/config", osc_handle_config);
   osc.dispatch("/rate", osc_handle_rate);
   osc.dispatch("/dutycycle", osc_handle_dutycycle);
+  osc.dispatch("/controlperiod", osc_handle_controlperiod);
 
   // LFO setup
-  lfo.set_period(sample_rate / 0.1);
+  lfo.set_rate(UQ16x16(0.1), timebase);
   lfo.set_duty_cycle(0.5);
+  params.attach(ParamRate, set_rate, NULL);           // Setters for mailbox parameters
+  params.attach(ParamDutyCycle, set_dutycycle, NULL);
 
   // Sigma delta setup
   sigmaDeltaEnable();
@@ -63,7 +81,7 @@ void setup() {
   // Sensor sampling timer setup
   system_timer_reinit();
   ets_timer_setfn(&sample_timer, render, NULL);
-  ets_timer_arm_new(&sample_timer, sample_period, true, 0); 
+  ets_timer_arm_new(&sample_timer, timebase.sample_period_us(), true, 0); 
 }
 
 // Main Loop
@@ -72,6 +90,7 @@ void loop() {
   wifi.loop();          // Maintains WiFi connection
   if (osc.loop())       // Parses any incoming UDP packets
     wifi_led.blink();   // Blink the LED if we handled an OSC message
+  params.loop();        // Applies the newest LFO parameters
   wifi_led.loop();      // Turns the LED back on if we blinked it over 20ms ago
 }
 
@@ -82,7 +101,7 @@ void loop() {
  * the ESP8266 we need to use sigmaDeltaWrite() 
  */
 void render(void *p_arg) {
-  sigmaDeltaWrite(0, lfo.render());   // Write CV to channel 0
+  sigmaDeltaWrite(0, dither.process(lfo.render_fine()));   // Write CV to channel 0
 }
 
 // WiFi Connect Handler:
@@ -94,6 +113,19 @@ void wifi_connected(void *userdata) {
   osc.open_port(wifi.get_iot_port());  
 }
 
+// LFO Parameter Setters:
+// ======================
+/* These functions get called by the parameter mailbox with the newest value posted
+ * by the matching OSC handler
+ */
+void set_rate(float rate, void *userdata) {
+  lfo.set_rate(UQ16x16(rate), timebase);
+}
+
+void set_dutycycle(float duty, void *userdata) {
+  lfo.set_duty_cycle(duty);
+}
+
 // OSC Handlers:
 // ============
 /* 
@@ -140,7 +172,7 @@ void osc_handle_rate(OSCMessage &msg) {
   else if (msg.isFloat(0))
     rate = msg.getFloat(0);
   else return;
-  lfo.set_period((uint32_t)(sample_rate / rate));
+  params.post(ParamRate, rate);
 }
 
 /* 
@@ -150,6 +182,17 @@ void osc_handle_rate(OSCMessage &msg) {
  */
 void osc_handle_dutycycle(OSCMessage &msg) {
   if (msg.isFloat(0))
-    lfo.set_duty_cycle(msg.getFloat(0));
+    params.post(ParamDutyCycle, msg.getFloat(0));
+}
+
+/* 
+ * /controlperiod <int>
+ * 
+ * Update the LFO state every n samples (power of two up to 256) and interpolate
+ * the samples in between; 1 updates every sample
+ */
+void osc_handle_controlperiod(OSCMessage &msg) {
+  if (msg.isInt(0))
+    lfo.set_control_period(msg.getInt(0));
 }
 
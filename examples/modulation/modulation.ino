@@ -0,0 +1,348 @@
+#define USE_US_TIMER    // Necessary for enabling ETSTimer's microsecond accuracy
+
+extern "C" {
+#include "user_interface.h"
+#include "ets_sys.h"
+#include "sigma_delta.h"
+}
+
+#include <WifiManager.h>
+#include <OSCManager.h>
+#include <LEDPin.h>
+#include <Timebase.h>
+#include <Oscillator.h>
+#include <Sequencer.h>
+#include <ModMatrix.h>
+#include <LoadGovernor.h>
+
+/* This pointer can point at the serial port if we're developing and debugging, or
+ * NULL if we're done working and want to deploy without wasting time printing */
+//Stream *debug = &Serial;  // Use this for development
+Stream *debug = NULL;     // Use this for deployment
+
+/* Back-end classes that do all the heavy lifting */
+LEDPin wifi_led(LED_BUILTIN, 20);     // WiFi Status and UDP/TCP I/O Indicator LED
+WifiManager wifi(LED_BUILTIN, debug); // WiFi Manager
+OSCManager osc(debug);                // Open Sound Control Manager
+
+/* Sample timer; calls the audio render callback function at a specified rate */
+ETSTimer sample_timer;                          // Sensor sample timer
+Timebase timebase(16000);                       // Sensor sample rate (Hz) and time conversions
+
+/* Load governor; picks the highest of these sample rates the render callback
+ * sustains at startup, then switches the generators to control-rate updates if the
+ * render callback overloads the sample period */
+const uint32_t sample_rates[] = {32000, 25000, 20000, 16000, 10000, 8000};
+LoadGovernor governor;
+
+// 8-bit LFO and sequencer, output (0-255); the sequencer is written to the output
+LFO8 lfo;
+SEQ8 seq;
+volatile uint16_t lfo_out = 0;
+volatile uint16_t seq_out = 0;
+
+/* Modulation matrix; routes are evaluated every 32 samples (2ms at 16kHz) in the render
+ * callback */
+ModMatrix mod;
+
+// Source and destination indices, as used by /route
+enum { SrcLFO = 0, SrcSeq };
+enum { DstGlideTime = 0, DstLFOPeriod, DstLFODepth };
+
+// Main Setup
+// ==========
+void setup() {
+
+  if (debug) 
+    Serial.begin(115200);
+  pinMode(LED_BUILTIN, OUTPUT);
+
+  // Set callback function for successful connection
+  wifi.set_connect_handler(wifi_connected, NULL);
+  
+  // Initilize and connect WiFi or open access point if we fail to connect
+  if (!wifi.init() || !wifi.connect()) 
+      wifi.open_access_point();
+
+  // Configure OSC Handlers
+  osc.dispatch("/ping", osc_handle_ping);
+  osc.dispatch("/config", osc_handle_config);
+  osc.dispatch("/sequence", osc_handle_sequence);
+  osc.dispatch("/steptime", osc_handle_steptime);
+  osc.dispatch("/glidetime", osc_handle_glidetime);
+  osc.dispatch("/rate", osc_handle_rate);
+  osc.dispatch("/depth", osc_handle_depth);
+  osc.dispatch("/gate", osc_handle_gate);
+  osc.dispatch("/route", osc_handle_route);
+  osc.dispatch("/unroute", osc_handle_unroute);
+  osc.dispatch("/load", osc_handle_load);
+
+  // Sequencer setup (times are set once the sample rate is known)
+  uint8_t val = 31;
+  for (int i = 0; i < 8; i++) {
+    seq.append_step(val);
+    val += 32;
+  }
+  seq.gate(true);
+
+  // Modulation setup; sources are in the order of SrcLFO, SrcSeq and
+  // destinations in the order of DstGlideTime, DstLFOPeriod, DstLFODepth
+  mod.add_source(&lfo_out);
+  mod.add_source(&seq_out);
+  mod.add_destination(set_glide_time, NULL, timebase.ms_to_samples(10), 1, SEQ8_LEN_MAX);
+  mod.add_destination(set_lfo_period, NULL, timebase.hz_to_period(UQ16x16(0.2)), 16, LFO8_LEN_MAX);
+  mod.add_destination(set_lfo_depth, NULL, LFO8_LEV_MAX, LFO8_LEV_MIN, LFO8_LEV_MAX);
+  mod.set_route(0, SrcLFO, DstGlideTime, 4 * MODMATRIX_UNITY);   // LFO sweeps glide up to 1020 samples (64ms at 16kHz)
+
+  // Sigma delta setup
+  sigmaDeltaEnable();
+  sigmaDeltaSetup(0, 240000);   // Set up channel 0 at PWM freq. of 240,000Hz
+  sigmaDeltaAttachPin(D1, 0);   // Use pin D1 on channel 0
+  // Note: sigma delta on ESP8266 is limited to 8 bits (0-255)
+
+  // Time the render callback and set times at the highest sustainable sample rate
+  timebase.set_sample_rate(governor.calibrate(render, NULL, sample_rates, 
+    sizeof(sample_rates) / sizeof(sample_rates[0])));
+  seq.set_step_length(UQ16x16(250), timebase);
+  mod.set_base(DstGlideTime, timebase.ms_to_samples(10));
+  mod.set_base(DstLFOPeriod, timebase.hz_to_period(UQ16x16(0.2)));
+  governor.set_level_handler(set_quality, NULL);
+  
+  // Sensor sampling timer setup
+  system_timer_reinit();
+  governor.start(&sample_timer, render, NULL, timebase.sample_rate());
+}
+
+// Main Loop
+// =========
+void loop() {
+  wifi.loop();          // Maintains WiFi connection
+  if (osc.loop())       // Parses any incoming UDP packets
+    wifi_led.blink();   // Blink the LED if we handled an OSC message
+  governor.loop();      // Degrades or restores quality with the render load
+  wifi_led.loop();      // Turns the LED back on if we blinked it over 20ms ago
+}
+
+// CV Render Callback:
+// ===================
+/* This function is called by ETSTimer at our specified sample rate. Both generators
+ * are rendered, then the modulation matrix updates their parameters once per block
+ */
+void render(void *p_arg) {
+  governor.begin();
+  lfo_out = lfo.render();
+  seq_out = seq.render();
+  mod.tick();
+  sigmaDeltaWrite(0, seq_out);   // Write CV to channel 0
+  governor.end();
+}
+
+// Load Governor Level Handler:
+// ============================
+/* This function is called by the governor from loop() when the render load changes
+ * the degrade level; each level updates the generators 4x less often
+ */
+void set_quality(uint8_t level, void *userdata) {
+  noInterrupts();
+  lfo.set_control_period(governor.control_period());
+  seq.set_control_period(governor.control_period());
+  interrupts();
+}
+
+// WiFi Connect Handler:
+// =====================
+/* This function is called by WifiManager when it successfully connects to a network.
+ * We use it to open a UDP port with the number specified in the WiFi config settings.
+ */
+void wifi_connected(void *userdata) {
+  osc.open_port(wifi.get_iot_port());  
+}
+
+// Modulation Destinations:
+// ========================
+/* These functions get called by the modulation matrix with a destination's base
+ * value plus its modulation, whenever that changes
+ */
+void set_glide_time(int32_t samples, void *userdata) {
+  seq.set_glide_length(samples);
+}
+
+void set_lfo_period(int32_t samples, void *userdata) {
+  lfo.set_period(samples);
+}
+
+void set_lfo_depth(int32_t level, void *userdata) {
+  lfo.set_depth(level);
+}
+
+// OSC Handlers:
+// ============
+/* 
+ * /ping
+ *  
+ * This function responds to a /ping message with this IoT device's device ID, node ID, 
+ * and IP address. We also 'connect' this device's UDP client to the IP address that 
+ * sent the /ping, so that any OSC messages sent from this device are sent to that 
+ * address on the IoT port 
+ */
+void osc_handle_ping(OSCMessage &msg) {
+  // Make the response message          
+  OSCMessage response("/pong");
+  char buff[32];
+  wifi.get_dev_id(buff);
+  response.add(buff);
+  wifi.get_node_id(buff);
+  response.add(buff);
+  response.add(wifi.get_local_address().toString().c_str());
+  // Set the /ping sender's IP as the destination address
+  osc.set_dest(osc.remote_addr(), wifi.get_iot_port());
+  // Send the response
+  osc.send(response);
+}
+
+/* 
+ * /config
+ *  
+ * Open access point to configure network settings and device/node identifiers
+ */
+void osc_handle_config(OSCMessage &msg) {
+  wifi.open_access_point();
+}
+
+/*
+ * /sequence <int/float> <int/float> ... <int/float>
+ * 
+ * Set up to 512 sequencer steps [0-255]
+ */
+void osc_handle_sequence(OSCMessage &msg) {
+  uint16_t n_args = msg.size();
+  uint8_t stepval;
+  for (int i = 0; i < n_args; i++) {
+    if (msg.isInt(i))
+      stepval = msg.getInt(i);
+    else if (msg.isFloat(i)) 
+      stepval = (uint8_t)msg.getFloat(i);
+    else
+      continue;
+    if (i < seq.num_steps())
+      seq.set_step(i, stepval);
+    else 
+      seq.append_step(stepval);
+  }
+}
+
+/*
+ * /steptime <int/float>
+ * 
+ * Sets the step duration in miliseconds
+ */
+void osc_handle_steptime(OSCMessage &msg) {
+  float time_ms;
+  if (msg.isInt(0))
+    time_ms = msg.getInt(0);
+  else if (msg.isFloat(0)) 
+    time_ms = msg.getFloat(0);
+  else return;
+  seq.set_step_length(timebase.ms_to_samples(time_ms));
+}
+
+/*
+ * /glidetime <int/float>
+ * 
+ * Set the unmodulated glide time in miliseconds
+ */
+void osc_handle_glidetime(OSCMessage &msg) {
+  float time_ms;
+  if (msg.isInt(0))
+    time_ms = msg.getInt(0);
+  else if (msg.isFloat(0)) 
+    time_ms = msg.getFloat(0);
+  else return;
+  mod.set_base(DstGlideTime, timebase.ms_to_samples(time_ms));
+}
+
+/* 
+ * /rate <int/float>
+ * 
+ * Set the unmodulated LFO rate in Hz
+ */
+void osc_handle_rate(OSCMessage &msg) {
+  UQ16x16 rate;
+  if (msg.isInt(0))     
+    rate = msg.getInt(0);
+  else if (msg.isFloat(0))
+    rate = msg.getFloat(0);
+  else return;
+  mod.set_base(DstLFOPeriod, timebase.hz_to_period(rate));
+}
+
+/* 
+ * /depth <int/float>
+ * 
+ * Set the unmodulated LFO depth [0-255]
+ */
+void osc_handle_depth(OSCMessage &msg) {
+  if (msg.isInt(0))     
+    mod.set_base(DstLFODepth, msg.getInt(0));
+  else if (msg.isFloat(0))
+    mod.set_base(DstLFODepth, round(msg.getFloat(0)));
+}
+
+/*
+ * /gate <int>
+ * 
+ * Turns the sequencer off (zero) or on (nonzero)
+ */
+void osc_handle_gate(OSCMessage &msg) {
+  if (msg.isInt(0)) 
+    seq.gate(msg.getInt(0) != 0);
+}
+
+/*
+ * /route <int> <int> <int> <int/float>
+ * 
+ * Set route [0-15] from source (0: LFO, 1: sequencer) to destination (0: glide 
+ * time, 1: LFO period, 2: LFO depth) with an amount in destination units (samples 
+ * or levels) per source level; an amount of 0 disables the route
+ */
+void osc_handle_route(OSCMessage &msg) {
+  float amount;
+  if (!msg.isInt(0) || !msg.isInt(1) || !msg.isInt(2))
+    return;
+  if (msg.isInt(3))
+    amount = (float)msg.getInt(3);
+  else if (msg.isFloat(3))
+    amount = msg.getFloat(3);
+  else return;
+  amount = constrain(amount * MODMATRIX_UNITY, -32767.0f, 32767.0f);
+  mod.set_route(msg.getInt(0), msg.getInt(1), msg.getInt(2), (int16_t)amount);
+}
+
+/*
+ * /unroute <int>
+ * 
+ * Disable route [0-15]
+ */
+void osc_handle_unroute(OSCMessage &msg) {
+  if (msg.isInt(0))
+    mod.clear_route(msg.getInt(0));
+}
+
+/*
+ * /load
+ *
+ * Responds with /load <sample rate> <load> <peak> <level> <missed>: the mean and
+ * peak render load over the last 125ms (1/1000 of the sample period), the degrade
+ * level (generator control period 4^level) and the ticks missed since startup
+ */
+void osc_handle_load(OSCMessage &msg) {
+  OSCMessage response("/load");
+  response.add((int32_t)timebase.sample_rate());
+  response.add((int32_t)governor.load());
+  response.add((int32_t)governor.peak());
+  response.add((int32_t)governor.level());
+  response.add((int32_t)governor.missed());
+  osc.set_dest(osc.remote_addr(), wifi.get_iot_port());
+  osc.send(response);
+}
+
@@ -0,0 +1,249 @@
+#define USE_US_TIMER    // Necessary for enabling ETSTimer's microsecond accuracy
+
+extern "C" {
+#include "user_interface.h"
+#include "ets_sys.h"
+#include "sigma_delta.h"
+}
+
+#include <WifiManager.h>
+#include <OSCManager.h>
+#include <LEDPin.h>
+#include <Timebase.h>
+#include <Dither.h>
+#include <Sequencer.h>
+#include <Quantizer.h>
+
+/* This pointer can point at the serial port if we're developing and debugging, or
+ * NULL if we're done working and want to deploy without wasting time printing */
+//Stream *debug = &Serial;  // Use this for development
+Stream *debug = NULL;     // Use this for deployment
+
+/* Back-end classes that do all the heavy lifting */
+LEDPin wifi_led(LED_BUILTIN, 20);     // WiFi Status and UDP/TCP I/O Indicator LED
+WifiManager wifi(LED_BUILTIN, debug); // WiFi Manager
+OSCManager osc(debug);                // Open Sound Control Manager
+
+/* Sample timer; calls the audio render callback function at a specified rate */
+ETSTimer sample_timer;                          // Sensor sample timer
+Timebase timebase(16000);                       // Sensor sample rate (Hz) and time conversions
+
+// Sequencer of note numbers
+SEQ8 seq;
+
+/* Quantizes the sequencer's notes to a scale and maps them to calibrated output
+ * levels; calibration is stored in EEPROM after the WiFi configuration */
+Quantizer quantizer(EEPROM_USER_ADDRESS, debug);
+
+/* Error-feedback dither; writes the calibrated level's fractional bits to the 8-bit
+ * sigma delta channel over time */
+Dither8 dither;
+
+// Main Setup
+// ==========
+void setup() {
+
+  if (debug)
+    Serial.begin(115200);
+  pinMode(LED_BUILTIN, OUTPUT);
+
+  // Set callback function for successful connection
+  wifi.set_connect_handler(wifi_connected, NULL);
+
+  // Initilize and connect WiFi or open access point if we fail to connect
+  if (!wifi.init() || !wifi.connect())
+      wifi.open_access_point();
+
+  // Load the calibration (EEPROM is started by wifi.init())
+  quantizer.init();
+  quantizer.set_scale(QNT_SCALE_MAJOR);
+
+  // Configure OSC Handlers
+  osc.dispatch("/ping", osc_handle_ping);
+  osc.dispatch("/config", osc_handle_config);
+  osc.dispatch("/notes", osc_handle_notes);
+  osc.dispatch("/steptime", osc_handle_steptime);
+  osc.dispatch("/gate", osc_handle_gate);
+  osc.dispatch("/scale", osc_handle_scale);
+  osc.dispatch("/root", osc_handle_root);
+  osc.dispatch("/cal", osc_handle_cal);
+  osc.dispatch("/cal/clear", osc_handle_cal_clear);
+  osc.dispatch("/cal/save", osc_handle_cal_save);
+
+  // Sequencer setup; notes change without gliding
+  seq.set_step_length(UQ16x16(250), timebase);
+  seq.set_glide_length(1);
+  uint8_t notes[] = {0, 2, 4, 5, 7, 9, 11, 12};
+  for (int i = 0; i < 8; i++)
+    seq.append_step(notes[i]);
+  seq.gate(true);
+
+  // Sigma delta setup
+  sigmaDeltaEnable();
+  sigmaDeltaSetup(0, 240000);   // Set up channel 0 at PWM freq. of 240,000Hz
+  sigmaDeltaAttachPin(D1, 0);   // Use pin D1 on channel 0
+  // Note: sigma delta on ESP8266 is limited to 8 bits (0-255)
+
+  // Sensor sampling timer setup
+  system_timer_reinit();
+  ets_timer_setfn(&sample_timer, render, NULL);
+  ets_timer_arm_new(&sample_timer, timebase.sample_period_us(), true, 0);
+}
+
+// Main Loop
+// =========
+void loop() {
+  wifi.loop();          // Maintains WiFi connection
+  if (osc.loop())       // Parses any incoming UDP packets
+    wifi_led.blink();   // Blink the LED if we handled an OSC message
+  wifi_led.loop();      // Turns the LED back on if we blinked it over 20ms ago
+}
+
+// CV Render Callback:
+// ===================
+/* This function is called by ETSTimer at our specified sample rate. The sequencer's
+ * note goes through one table lookup (scale and calibration) and the dither
+ */
+void render(void *p_arg) {
+  sigmaDeltaWrite(0, dither.process(quantizer.process(seq.render())));  // Write CV to channel 0
+}
+
+// WiFi Connect Handler:
+// =====================
+/* This function is called by WifiManager when it successfully connects to a network.
+ * We use it to open a UDP port with the number specified in the WiFi config settings.
+ */
+void wifi_connected(void *userdata) {
+  osc.open_port(wifi.get_iot_port());
+}
+
+// OSC Handlers:
+// ============
+/*
+ * /ping
+ *
+ * This function responds to a /ping message with this IoT device's device ID, node ID,
+ * and IP address. We also 'connect' this device's UDP client to the IP address that
+ * sent the /ping, so that any OSC messages sent from this device are sent to that
+ * address on the IoT port
+ */
+void osc_handle_ping(OSCMessage &msg) {
+  // Make the response message
+  OSCMessage response("/pong");
+  char buff[32];
+  wifi.get_dev_id(buff);
+  response.add(buff);
+  wifi.get_node_id(buff);
+  response.add(buff);
+  response.add(wifi.get_local_address().toString().c_str());
+  // Set the /ping sender's IP as the destination address
+  osc.set_dest(osc.remote_addr(), wifi.get_iot_port());
+  // Send the response
+  osc.send(response);
+}
+
+/*
+ * /config
+ *
+ * Open access point to configure network settings and device/node identifiers
+ */
+void osc_handle_config(OSCMessage &msg) {
+  wifi.open_access_point();
+}
+
+/*
+ * /notes <int> <int> ... <int>
+ *
+ * Set the sequence to up to 512 note numbers [0-255]; notes are quantized to the
+ * current scale on output
+ */
+void osc_handle_notes(OSCMessage &msg) {
+  seq.clear();
+  for (int i = 0; i < msg.size(); i++) {
+    if (msg.isInt(i))
+      seq.append_step(msg.getInt(i));
+  }
+}
+
+/*
+ * /steptime <int/float>
+ *
+ * Sets the step duration in miliseconds
+ */
+void osc_handle_steptime(OSCMessage &msg) {
+  float time_ms;
+  if (msg.isInt(0))
+    time_ms = msg.getInt(0);
+  else if (msg.isFloat(0))
+    time_ms = msg.getFloat(0);
+  else return;
+  seq.set_step_length(timebase.ms_to_samples(time_ms));
+}
+
+/*
+ * /gate <int>
+ *
+ * Run (1) or hold (0) the sequence
+ */
+void osc_handle_gate(OSCMessage &msg) {
+  if (msg.isInt(0))
+    seq.gate(msg.getInt(0));
+}
+
+/*
+ * /scale <int>
+ *
+ * Set the scale mask; bit i allows the note i semitones above the root (e.g. 2741
+ * major, 1453 minor, 661 pentatonic, 4095 chromatic, 0 unquantized)
+ */
+void osc_handle_scale(OSCMessage &msg) {
+  if (msg.isInt(0))
+    quantizer.set_scale(msg.getInt(0));
+}
+
+/*
+ * /root <int>
+ *
+ * Set the root note of the scale [0-11]
+ */
+void osc_handle_root(OSCMessage &msg) {
+  if (msg.isInt(0))
+    quantizer.set_root(msg.getInt(0));
+}
+
+/*
+ * /cal <int> <int/float>
+ *
+ * Set the calibration point for a note: the 8-bit output level [0-255] (fractional
+ * levels allowed) that produces the note's voltage at the output. Points are
+ * interpolated; with none set, notes are spaced 1V/oct from level 0.
+ */
+void osc_handle_cal(OSCMessage &msg) {
+  uint16_t level;
+  if (!msg.isInt(0))
+    return;
+  if (msg.isInt(1))
+    level = msg.getInt(1) << 8;
+  else if (msg.isFloat(1))
+    level = (uint16_t)(msg.getFloat(1) * 256);
+  else return;
+  quantizer.set_point(msg.getInt(0), level);
+}
+
+/*
+ * /cal/clear
+ *
+ * Remove all calibration points (until /cal/save, the saved points are kept)
+ */
+void osc_handle_cal_clear(OSCMessage &msg) {
+  quantizer.clear_points();
+}
+
+/*
+ * /cal/save
+ *
+ * Store the calibration points in EEPROM
+ */
+void osc_handle_cal_save(OSCMessage &msg) {
+  quantizer.save_calibration();
+}
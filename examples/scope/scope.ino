@@ -0,0 +1,237 @@
+#define USE_US_TIMER    // Necessary for enabling ETSTimer's microsecond accuracy
+
+extern "C" {
+#include "user_interface.h"
+#include "ets_sys.h"
+#include "sigma_delta.h"
+}
+
+#include <WifiManager.h>
+#include <OSCManager.h>
+#include <LEDPin.h>
+#include <Timebase.h>
+#include <Sequencer.h>
+#include <Gate.h>
+#include <Telemetry.h>
+
+/* Pin for the reset input (3.3V logic); rising edges restart the sequence */
+#define RESET_PIN D2
+
+/* This pointer can point at the serial port if we're developing and debugging, or
+ * NULL if we're done working and want to deploy without wasting time printing */
+//Stream *debug = &Serial;  // Use this for development
+Stream *debug = NULL;     // Use this for deployment
+
+/* Back-end classes that do all the heavy lifting */
+LEDPin wifi_led(LED_BUILTIN, 20);     // WiFi Status and UDP/TCP I/O Indicator LED
+WifiManager wifi(LED_BUILTIN, debug); // WiFi Manager
+OSCManager osc(debug);                // Open Sound Control Manager
+
+/* Sample timer; calls the audio render callback function at a specified rate */
+ETSTimer sample_timer;                          // Sensor sample timer
+Timebase timebase(16000);                       // Sensor sample rate (Hz) and time conversions
+
+// 8-bit sequencer, outputs (0-255)
+SEQ8 seq;
+
+/* Reset input, sampled every render tick and bound to the sequencer's reset() */
+Gate reset_in(0, 1023, EEPROM_USER_ADDRESS, debug);
+
+/* Signals for telemetry, updated by the render callback; the load is the render
+ * callback's share of the sample period, in 1/1000 */
+volatile uint16_t seq_out = 0;
+volatile uint16_t seq_step = 0;
+volatile uint16_t gate_value = 0;
+volatile uint16_t gate_state = 0;
+volatile uint16_t render_load = 0;
+uint32_t cycles_per_sample;
+
+/* Streams subscribed signals to the /ping sender as /scope messages */
+Telemetry telemetry(osc, "/scope");
+
+// Main Setup
+// ==========
+void setup() {
+
+  if (debug)
+    Serial.begin(115200);
+  pinMode(LED_BUILTIN, OUTPUT);
+  pinMode(RESET_PIN, INPUT);
+
+  // Set callback function for successful connection
+  wifi.set_connect_handler(wifi_connected, NULL);
+
+  // Initilize and connect WiFi or open access point if we fail to connect
+  if (!wifi.init() || !wifi.connect())
+      wifi.open_access_point();
+
+  // Reset input (EEPROM is started by wifi.init())
+  reset_in.init();
+  reset_in.bind_reset(seq);
+
+  // Configure OSC Handlers
+  osc.dispatch("/ping", osc_handle_ping);
+  osc.dispatch("/config", osc_handle_config);
+  osc.dispatch("/sequence", osc_handle_sequence);
+  osc.dispatch("/steptime", osc_handle_steptime);
+  osc.dispatch("/subscribe", osc_handle_subscribe);
+  osc.dispatch("/scoperate", osc_handle_scoperate);
+
+  // Telemetry signals; indices 0-4 in /subscribe masks
+  telemetry.add_signal(&seq_out);
+  telemetry.add_signal(&seq_step);
+  telemetry.add_signal(&gate_value);
+  telemetry.add_signal(&gate_state);
+  telemetry.add_signal(&render_load);
+  cycles_per_sample = ESP.getCpuFreqMHz() * timebase.sample_period_us();
+
+  // Sequencer setup
+  seq.set_step_length(UQ16x16(250), timebase);
+  uint8_t val = 31;
+  for (int i = 0; i < 8; i++) {
+    seq.append_step(val);
+    val += 32;
+  }
+  seq.gate(true);
+
+  // Sigma delta setup
+  sigmaDeltaEnable();
+  sigmaDeltaSetup(0, 240000);   // Set up channel 0 at PWM freq. of 240,000Hz
+  sigmaDeltaAttachPin(D1, 0);   // Use pin D1 on channel 0
+  // Note: sigma delta on ESP8266 is limited to 8 bits (0-255)
+
+  // Sensor sampling timer setup
+  system_timer_reinit();
+  ets_timer_setfn(&sample_timer, render, NULL);
+  ets_timer_arm_new(&sample_timer, timebase.sample_period_us(), true, 0);
+}
+
+// Main Loop
+// =========
+void loop() {
+  wifi.loop();          // Maintains WiFi connection
+  if (osc.loop())       // Parses any incoming UDP packets
+    wifi_led.blink();   // Blink the LED if we handled an OSC message
+  telemetry.loop();     // Sends a /scope blob if one is full
+  wifi_led.loop();      // Turns the LED back on if we blinked it over 20ms ago
+}
+
+// CV Render Callback:
+// ===================
+/* This function is called by ETSTimer at our specified sample rate. Besides the
+ * output, it updates the telemetry signals and lets telemetry record them
+ */
+void render(void *p_arg) {
+  uint32_t t0 = ESP.getCycleCount();
+  int in = digitalRead(RESET_PIN) ? 1023 : 0;
+  reset_in.process(in);               // Resets the sequencer on rising edges
+  seq_out = seq.render();
+  sigmaDeltaWrite(0, seq_out);        // Write CV to channel 0
+  seq_step = seq.current_step();
+  gate_value = in;
+  gate_state = reset_in.get_state();
+  telemetry.tick();
+  render_load = (uint32_t)(ESP.getCycleCount() - t0) * 1000 / cycles_per_sample;
+}
+
+// WiFi Connect Handler:
+// =====================
+/* This function is called by WifiManager when it successfully connects to a network.
+ * We use it to open a UDP port with the number specified in the WiFi config settings.
+ */
+void wifi_connected(void *userdata) {
+  osc.open_port(wifi.get_iot_port());
+}
+
+// OSC Handlers:
+// ============
+/*
+ * /ping
+ *
+ * This function responds to a /ping message with this IoT device's device ID, node ID,
+ * and IP address. We also 'connect' this device's UDP client to the IP address that
+ * sent the /ping, so that any OSC messages sent from this device are sent to that
+ * address on the IoT port
+ */
+void osc_handle_ping(OSCMessage &msg) {
+  // Make the response message
+  OSCMessage response("/pong");
+  char buff[32];
+  wifi.get_dev_id(buff);
+  response.add(buff);
+  wifi.get_node_id(buff);
+  response.add(buff);
+  response.add(wifi.get_local_address().toString().c_str());
+  // Set the /ping sender's IP as the destination address
+  osc.set_dest(osc.remote_addr(), wifi.get_iot_port());
+  // Send the response
+  osc.send(response);
+}
+
+/*
+ * /config
+ *
+ * Open access point to configure network settings and device/node identifiers
+ */
+void osc_handle_config(OSCMessage &msg) {
+  wifi.open_access_point();
+}
+
+/*
+ * /sequence <int/float> <int/float> ... <int/float>
+ *
+ * Set up to 512 sequencer steps [0-255]
+ */
+void osc_handle_sequence(OSCMessage &msg) {
+  seq.clear();
+  for (int i = 0; i < msg.size(); i++) {
+    if (msg.isInt(i))
+      seq.append_step(msg.getInt(i));
+    else if (msg.isFloat(i))
+      seq.append_step((uint8_t)msg.getFloat(i));
+  }
+}
+
+/*
+ * /steptime <int/float>
+ *
+ * Sets the step duration in miliseconds
+ */
+void osc_handle_steptime(OSCMessage &msg) {
+  float time_ms;
+  if (msg.isInt(0))
+    time_ms = msg.getInt(0);
+  else if (msg.isFloat(0))
+    time_ms = msg.getFloat(0);
+  else return;
+  seq.set_step_length(timebase.ms_to_samples(time_ms));
+}
+
+/*
+ * /subscribe <int>
+ *
+ * Select the signals to stream: bit 0 output, 1 step, 2 reset input value, 3 reset
+ * input state, 4 render load (e.g. 3 streams output and step; 0 stops streaming)
+ */
+void osc_handle_subscribe(OSCMessage &msg) {
+  if (msg.isInt(0))
+    telemetry.subscribe(msg.getInt(0));
+}
+
+/*
+ * /scoperate <int/float>
+ *
+ * Set the telemetry frame rate in Hz (up to the 16kHz sample rate)
+ */
+void osc_handle_scoperate(OSCMessage &msg) {
+  float hz;
+  if (msg.isInt(0))
+    hz = msg.getInt(0);
+  else if (msg.isFloat(0))
+    hz = msg.getFloat(0);
+  else return;
+  if (hz <= 0)
+    return;
+  float n = timebase.sample_rate() / hz;
+  telemetry.set_decimation(n < 65535 ? n : 65535);    // Slowest: one frame per 65535 samples
+}
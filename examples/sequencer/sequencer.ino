@@ -9,7 +9,11 @@ extern "C" {
 #include <WifiManager.h>
 #include <OSCManager.h>
 #include <LEDPin.h>
+#include <Timebase.h>
+#include <Dither.h>
 #include <Sequencer.h>
+#include <ParamMailbox.h>
+#include <PresetStore.h>
 
 /* This pointer can point at the serial port if we're developing and debugging, or
  * NULL if we're done working and want to deploy without wasting time printing */
@@ -20,15 +24,33 @@ Stream *debug = NULL;     // Use this for deployment
 LEDPin wifi_led(LED_BUILTIN, 20);     // WiFi Status and UDP/TCP I/O Indicator LED
 WifiManager wifi(LED_BUILTIN, debug); // WiFi Manager
 OSCManager osc(debug);                // Open Sound Control Manager
+uint8_t loop_buffer[OSC_LOOP_BUFFER_LEN];  // Looper memory (4KB)
 
 /* Sample timer; calls the audio render callback function at a specified rate */
 ETSTimer sample_timer;                          // Sensor sample timer
-const float sample_rate = 16000;                // Sensor sample rate (Hz)
-const float sample_period = 1e6 / sample_rate;  // Sensor sample period (microseconds)
+Timebase timebase(16000);                       // Sensor sample rate (Hz) and time conversions
 
 // 8-bit sequencer, outputs (0-255)
 SEQ8 seq;
 
+/* Error-feedback dither; writes the generator's fractional bits to the 8-bit sigma
+ * delta channel over time, so the filtered CV has finer steps than 8 bits */
+Dither8 dither;
+
+/* Continuous parameters are posted here by the OSC handlers; only the newest value
+ * of each is applied to the sequencer, at most once per control period (5ms) */
+enum {
+  ParamStepTime = 0,
+  ParamGlideTime,
+  NumParams
+};
+ParamMailbox<NumParams> params;
+
+/* Preset slots in flash; a scene (sequencer parameters and steps) is serialized
+ * into the preset buffer, then written to or read from a slot */
+PresetStore presets;
+Preset preset;
+
 // Main Setup
 // ==========
 void setup() {
@@ -44,26 +66,43 @@ void setup() {
   if (!wifi.init() || !wifi.connect()) 
       wifi.open_access_point();
 
+  // Looper; replays only the handlers dispatched as loopable (true) below
+  osc.set_loop_buffer(loop_buffer, sizeof(loop_buffer));
+
   // Configure OSC Handlers
   osc.dispatch("/ping", osc_handle_ping);
   osc.dispatch("/config", osc_handle_config);
-  osc.dispatch("/sequence", osc_handle_sequence);
-  osc.dispatch("/steptime", osc_handle_steptime);
-  osc.dispatch("/glidetime", osc_handle_glidetime);
-  osc.dispatch("/timedsequence", osc_handle_timedsequence);
-  osc.dispatch("/append", osc_handle_append);
-  osc.dispatch("/clear", osc_handle_clear);
-  osc.dispatch("/gate", osc_handle_gate);
-  osc.dispatch("/reset", osc_handle_reset);
+  osc.dispatch("/sequence", osc_handle_sequence, true);
+  osc.dispatch("/steptime", osc_handle_steptime, true);
+  osc.dispatch("/glidetime", osc_handle_glidetime, true);
+  osc.dispatch("/glidecurve", osc_handle_glidecurve, true);
+  osc.dispatch("/timedsequence", osc_handle_timedsequence, true);
+  osc.dispatch("/append", osc_handle_append, true);
+  osc.dispatch("/clear", osc_handle_clear, true);
+  osc.dispatch("/gate", osc_handle_gate, true);
+  osc.dispatch("/reset", osc_handle_reset, true);
+  osc.dispatch("/euclid", osc_handle_euclid, true);
+  osc.dispatch("/randomwalk", osc_handle_randomwalk, true);
+  osc.dispatch("/rotate", osc_handle_rotate, true);
+  osc.dispatch("/transpose", osc_handle_transpose, true);
+  osc.dispatch("/reverse", osc_handle_reverse, true);
+  osc.dispatch("/preset/save", osc_handle_preset_save);
+  osc.dispatch("/preset/load", osc_handle_preset_load, true);
+
+  // Mount the preset filesystem
+  presets.begin();
  
   // Sequencer setup
   // ===============
   // Set end-of-sequence handler
   seq.set_eos_handler(end_of_sequence, NULL);
+
+  // Setters for mailbox parameters
+  params.attach(ParamStepTime, set_steptime, NULL);
+  params.attach(ParamGlideTime, set_glidetime, NULL);
   
   // Initial sequencer step length
-  float steptime_ms = 500.0;
-  seq.set_step_length((uint32_t)(steptime_ms/1000.0 * sample_rate));
+  seq.set_step_length(UQ16x16(500), timebase);
   
   // Initial sequence
   uint8_t val = 31;
@@ -82,7 +121,7 @@ void setup() {
   // Sensor sampling timer setup
   system_timer_reinit();
   ets_timer_setfn(&sample_timer, render, NULL);
-  ets_timer_arm_new(&sample_timer, sample_period, true, 0); 
+  ets_timer_arm_new(&sample_timer, timebase.sample_period_us(), true, 0); 
 }
 
 // Main Loop
@@ -91,6 +130,7 @@ void loop() {
   wifi.loop();          // Maintains WiFi connection
   if (osc.loop())       // Parses any incoming UDP packets
     wifi_led.blink();   // Blink the LED if we handled an OSC message
+  params.loop();        // Applies the newest sequencer parameters
   wifi_led.loop();      // Turns the LED back on if we blinked it over 20ms ago
 }
 
@@ -101,7 +141,8 @@ void loop() {
  * the ESP8266 we need to use sigmaDeltaWrite() 
  */
 void render(void *p_arg) {
-  sigmaDeltaWrite(0, seq.render());   // Write CV to channel 0
+  sigmaDeltaWrite(0, dither.process(seq.render_fine()));   // Write CV to channel 0
+  osc.tick();                                              // Advances the looper clock
 }
 
 // WiFi Connect Handler:
@@ -120,6 +161,20 @@ void end_of_sequence(void *userdata) {
   osc.send(msg);          // Send a message back to Max/MSP
 }
 
+// Sequencer Parameter Setters:
+// ============================
+/* These functions get called by the parameter mailbox with the newest value posted
+ * by the matching OSC handler
+ */
+void set_steptime(float time_ms, void *userdata) {
+  seq.set_step_length(timebase.ms_to_samples(time_ms));
+  seq.uniform_step = true;
+}
+
+void set_glidetime(float time_ms, void *userdata) {
+  seq.set_glide_length(timebase.ms_to_samples(time_ms));
+}
+
 // OSC Handlers:
 // ============
 /* 
@@ -198,8 +253,7 @@ void osc_handle_steptime(OSCMessage &msg) {
   else if (msg.isFloat(0)) 
     time_ms = msg.getFloat(0);
   else return;
-  seq.set_step_length((uint32_t)(time_ms/1000.0 * sample_rate));
-  seq.uniform_step = true;
+  params.post(ParamStepTime, time_ms);
 } 
 
 /*
@@ -214,9 +268,20 @@ void osc_handle_glidetime(OSCMessage &msg) {
   else if (msg.isFloat(0)) 
     time_ms = msg.getFloat(0);
   else return;
-  seq.set_glide_length((uint32_t)(time_ms/1000.0 * sample_rate));
+  params.post(ParamGlideTime, time_ms);
 } 
 
+/*
+ * /glidecurve <int>
+ *
+ * Set the glide curvature [-8-8]: 0 is linear, positive curves move fast first,
+ * negative ones slow first
+ */
+void osc_handle_glidecurve(OSCMessage &msg) {
+  if (msg.isInt(0))
+    seq.set_glide_curve(msg.getInt(0));
+}
+
 /*
  * /timedsequence <int/float> <int/float> ... <int/float>
  * 
@@ -224,7 +289,8 @@ void osc_handle_glidetime(OSCMessage &msg) {
  * and step times in miliseconds; 
  */
 void osc_handle_timedsequence(OSCMessage &msg) {
-  
+
+  params.flush();     // Apply a pending /steptime before leaving uniform step mode
   uint16_t n_args = msg.size();
   uint8_t stepval;
   float steptime_ms;
@@ -242,10 +308,10 @@ void osc_handle_timedsequence(OSCMessage &msg) {
       continue;
     }
 
-    // Convert integer time(ms) to float or get float; 
+    // Get integer or float time(ms); 
     // otherwise ignore this argument pair
     if (msg.isInt(i))
-      steptime_ms = (float)msg.getInt(i);
+      steptime_ms = msg.getInt(i);
     else if (msg.isFloat(i))
       steptime_ms = msg.getFloat(i);
     else {
@@ -256,11 +322,11 @@ void osc_handle_timedsequence(OSCMessage &msg) {
     
     // If the sequencer already has a step for this index, set it
     if (i < seq.num_steps())
-      seq.set_step(i, stepval, (uint32_t)(steptime_ms/1000.0 * sample_rate));
+      seq.set_step(i, stepval, timebase.ms_to_samples(steptime_ms));
     
     // Otherwise append a new step
     else 
-      seq.append_step(stepval, (uint32_t)(steptime_ms/1000.0 * sample_rate));
+      seq.append_step(stepval, timebase.ms_to_samples(steptime_ms));
 
     seq.uniform_step = false;
   }
@@ -278,6 +344,7 @@ void osc_handle_timedsequence(OSCMessage &msg) {
  */
 void osc_handle_append(OSCMessage &msg) {
 
+  params.flush();     // Apply a pending /steptime before leaving uniform step mode
   uint8_t stepval;
   float steptime_ms;
 
@@ -290,10 +357,10 @@ void osc_handle_append(OSCMessage &msg) {
   // Check for a step duration
   if (msg.size() > 1) {
     if (msg.isInt(1))
-      steptime_ms = (float)msg.getInt(1);
+      steptime_ms = msg.getInt(1);
     else if (msg.isFloat(1))
       steptime_ms = msg.getFloat(1);
-    seq.append_step(stepval, (uint32_t)(steptime_ms/1000.0 * sample_rate));
+    seq.append_step(stepval, timebase.ms_to_samples(steptime_ms));
     seq.uniform_step = false;
   }
   else
@@ -315,8 +382,10 @@ void osc_handle_clear(OSCMessage &msg) {
  * Turns the sequencer off (zero) or on (nonzero)
  */
 void osc_handle_gate(OSCMessage &msg) {
-  if (msg.isInt(0)) 
+  if (msg.isInt(0)) {
+    params.flush();   // Apply parameters received before the gate first
     seq.gate(msg.getInt(0) != 0);
+  }
 }
 
 /*
@@ -325,6 +394,107 @@ void osc_handle_gate(OSCMessage &msg) {
  * Resets sequence to the first step
  */
 void osc_handle_reset(OSCMessage &msg) {
+  params.flush();     // Apply parameters received before the reset first
   seq.reset();
 }
 
+
+/*
+ * /euclid <int> <int> [<int>] [<int> <int>]
+ * 
+ * Replaces the sequence with a Euclidean rhythm: k onsets spread evenly over n 
+ * steps, optionally rotated by r steps, with onset/rest values (default 255/0)
+ */
+void osc_handle_euclid(OSCMessage &msg) {
+  if (!msg.isInt(0) || !msg.isInt(1))
+    return;
+  int16_t rot = msg.isInt(2) ? msg.getInt(2) : 0;
+  uint16_t on = msg.isInt(3) ? msg.getInt(3) : SEQ8_LEV_MAX;
+  uint16_t off = msg.isInt(4) ? msg.getInt(4) : SEQ8_LEV_MIN;
+  params.flush();     // Apply a pending /steptime before generating steps
+  seq.euclid(msg.getInt(0), msg.getInt(1), rot, on, off);
+  seq.uniform_step = true;
+}
+
+/*
+ * /randomwalk <int> <int> [<int> <int>]
+ * 
+ * Replaces the sequence with n steps of a random walk from the given seed, 
+ * starting at a value (default 127) and moving at most a maximum step (default 16);
+ * the same seed always gives the same pattern, on every device
+ */
+void osc_handle_randomwalk(OSCMessage &msg) {
+  if (!msg.isInt(0) || !msg.isInt(1))
+    return;
+  uint16_t start = msg.isInt(2) ? msg.getInt(2) : 127;
+  uint16_t max_step = msg.isInt(3) ? msg.getInt(3) : 16;
+  params.flush();     // Apply a pending /steptime before generating steps
+  seq.random_walk(msg.getInt(0), msg.getInt(1), start, max_step);
+  seq.uniform_step = true;
+}
+
+/*
+ * /rotate <int>
+ * 
+ * Shifts every step k places later, wrapping around (negative k shifts earlier)
+ */
+void osc_handle_rotate(OSCMessage &msg) {
+  if (msg.isInt(0))
+    seq.rotate(msg.getInt(0));
+}
+
+/*
+ * /transpose <int>
+ * 
+ * Adds an offset to every step value
+ */
+void osc_handle_transpose(OSCMessage &msg) {
+  if (msg.isInt(0))
+    seq.transpose(msg.getInt(0));
+}
+
+/*
+ * /reverse
+ * 
+ * Reverses the order of the steps
+ */
+void osc_handle_reverse(OSCMessage &msg) {
+  seq.reverse();
+}
+
+/*
+ * /preset/save <int>
+ *
+ * Store the sequencer parameters and steps in a preset slot [0-15]
+ */
+void osc_handle_preset_save(OSCMessage &msg) {
+  if (!msg.isInt(0))
+    return;
+  int slot = msg.getInt(0);
+  if (slot < 0 || slot >= PRESET_NUM_SLOTS)
+    return;         // Don't let the slot wrap into range as a uint8_t
+  params.flush();   // Include parameters received before the save
+  preset.clear();
+  seq.save(preset);
+  presets.save(slot, preset);
+}
+
+/*
+ * /preset/load <int>
+ *
+ * Recall a preset slot [0-15]. The slot is read from flash first, then applied with
+ * the render timer held off, so the whole scene changes between two samples.
+ */
+void osc_handle_preset_load(OSCMessage &msg) {
+  if (!msg.isInt(0))
+    return;
+  int slot = msg.getInt(0);
+  if (slot < 0 || slot >= PRESET_NUM_SLOTS)
+    return;
+  params.flush();   // Don't let parameters received before the load override it
+  if (!presets.load(slot, preset))
+    return;
+  noInterrupts();
+  seq.load(preset);
+  interrupts();
+}
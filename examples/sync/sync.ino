@@ -0,0 +1,322 @@
+#define USE_US_TIMER    // Necessary for enabling ETSTimer's microsecond accuracy
+
+extern "C" {
+#include "user_interface.h"
+#include "ets_sys.h"
+#include "sigma_delta.h"
+}
+
+#include <WifiManager.h>
+#include <OSCManager.h>
+#include <LEDPin.h>
+#include <Timebase.h>
+#include <Oscillator.h>
+#include <Sequencer.h>
+#include <ClockSync.h>
+
+/* Number of virtual nodes hosted by this device. Each one listens on its own UDP
+ * port (IoT port + index) with its own OSCManager, clock and generators, so the
+ * sync protocol can be tried on a single device; use 1 on every device of a real
+ * fleet */
+#define SYNC_NUM_NODES 4
+
+/* This pointer can point at the serial port if we're developing and debugging, or
+ * NULL if we're done working and want to deploy without wasting time printing */
+//Stream *debug = &Serial;  // Use this for development
+Stream *debug = NULL;     // Use this for deployment
+
+/* Back-end classes that do all the heavy lifting */
+LEDPin wifi_led(LED_BUILTIN, 20);     // WiFi Status and UDP/TCP I/O Indicator LED
+WifiManager wifi(LED_BUILTIN, debug); // WiFi Manager
+
+/* Sample timer; calls the audio render callback function at a specified rate */
+ETSTimer sample_timer;                          // Sensor sample timer
+Timebase timebase(16000);                       // Sensor sample rate (Hz) and time conversions
+
+// Virtual node: identity, OSC manager, synchronized clock and generators
+struct SyncNode {
+  char node_id[NODE_ID_MAX_LENGTH + 4];   // <NodeID>.<index>
+  uint16_t port;                          // Listening port
+  OSCManager osc;                         // Open Sound Control Manager
+  ClockSync sync;                         // Sample clock, following the master's
+  LFO8 lfo;                               // 8-bit LFO, outputs (0-255)
+  SEQ8 seq;                               // 8-bit sequencer, outputs (0-255)
+  volatile uint16_t lfo_out;
+  volatile uint16_t seq_out;
+  int32_t skew_ppm;                       // Simulated crystal error
+  uint32_t skew_step;                     // - per tick (Q32)
+  uint32_t skew_acc;
+};
+
+SyncNode nodes[SYNC_NUM_NODES];
+SyncNode *current = NULL;    // Node whose OSC handlers are being called
+
+// Main Setup
+// ==========
+void setup() {
+
+  if (debug)
+    Serial.begin(115200);
+  pinMode(LED_BUILTIN, OUTPUT);
+
+  // Set callback function for successful connection
+  wifi.set_connect_handler(wifi_connected, NULL);
+
+  // Initilize and connect WiFi or open access point if we fail to connect
+  if (!wifi.init() || !wifi.connect())
+      wifi.open_access_point();
+
+  // Configure OSC Handlers, clocks and generators for every virtual node
+  char node_id[NODE_ID_MAX_LENGTH];
+  wifi.get_node_id(node_id);
+  for (int i = 0; i < SYNC_NUM_NODES; i++) {
+    SyncNode &node = nodes[i];
+    sprintf(node.node_id, "%s.%d", node_id, i);
+    node.osc.set_clock_sync(&node.sync);
+    node.osc.dispatch("/ping", osc_handle_ping);
+    node.osc.dispatch("/config", osc_handle_config);
+    node.osc.dispatch("/rate", osc_handle_rate);
+    node.osc.dispatch("/dutycycle", osc_handle_dutycycle);
+    node.osc.dispatch("/sequence", osc_handle_sequence);
+    node.osc.dispatch("/steptime", osc_handle_steptime);
+    node.osc.dispatch("/sync/master", osc_handle_sync_master);
+    node.osc.dispatch("/sync/skew", osc_handle_sync_skew);
+    node.osc.dispatch("/sync/status", osc_handle_sync_status);
+    node.lfo.set_rate(UQ16x16(1), timebase);
+    node.lfo.set_duty_cycle(0.5);
+    node.seq.set_step_length(UQ16x16(250), timebase);
+    uint8_t val = 31;
+    for (int j = 0; j < 8; j++) {
+      node.seq.append_step(val);
+      val += 32;
+    }
+    node.seq.gate(true);
+    node.lfo_out = node.seq_out = 0;
+    set_skew(node, 0);
+  }
+
+  // Sigma delta setup; node 0's LFO on D1 and sequencer on D2
+  sigmaDeltaEnable();
+  sigmaDeltaSetup(0, 240000);   // Set up channel 0 at PWM freq. of 240,000Hz
+  sigmaDeltaAttachPin(D1, 0);   // Use pin D1 on channel 0
+  sigmaDeltaSetup(1, 240000);   // Set up channel 1 at PWM freq. of 240,000Hz
+  sigmaDeltaAttachPin(D2, 1);   // Use pin D2 on channel 1
+  // Note: sigma delta on ESP8266 is limited to 8 bits (0-255)
+
+  // Sensor sampling timer setup
+  system_timer_reinit();
+  ets_timer_setfn(&sample_timer, render, NULL);
+  ets_timer_arm_new(&sample_timer, timebase.sample_period_us(), true, 0);
+}
+
+// Main Loop
+// =========
+void loop() {
+  wifi.loop();                // Maintains WiFi connection
+  for (int i = 0; i < SYNC_NUM_NODES; i++) {
+    current = &nodes[i];
+    if (current->osc.loop())  // Parses any incoming UDP packets for this node
+      wifi_led.blink();       // Blink the LED if we handled an OSC message
+    if (current->sync.stepped())
+      align(*current);        // Realign the generators if the clock jumped
+  }
+  wifi_led.loop();            // Turns the LED back on if we blinked it over 20ms ago
+}
+
+// CV Render Callback:
+// ===================
+/* This function is called by ETSTimer at our specified sample rate. Each node's
+ * clock says how many samples to render (0, 1 or 2) to keep in step with the
+ * master; a simulated crystal error skips or doubles ticks beforehand
+ */
+void render(void *p_arg) {
+  for (int i = 0; i < SYNC_NUM_NODES; i++) {
+    SyncNode &node = nodes[i];
+    uint8_t ticks = 1;
+    if (node.skew_step) {
+      uint32_t acc = node.skew_acc + node.skew_step;
+      if (acc < node.skew_acc)
+        ticks = node.skew_ppm > 0 ? 2 : 0;
+      node.skew_acc = acc;
+    }
+    while (ticks--) {
+      uint8_t n = node.sync.tick();
+      while (n--) {
+        node.lfo_out = node.lfo.render();
+        node.seq_out = node.seq.render();
+      }
+    }
+  }
+  sigmaDeltaWrite(0, nodes[0].lfo_out);   // Write CV to channel 0
+  sigmaDeltaWrite(1, nodes[0].seq_out);   // Write CV to channel 1
+}
+
+// Generator Alignment:
+// ====================
+/* Generators with the same settings are a function of the synchronized time, so
+ * each node moves them to the master's time after its clock steps or their
+ * settings change
+ */
+void align(SyncNode &node) {
+  noInterrupts();
+  uint32_t t = node.sync.now();
+  node.lfo.set_phase(t);
+  node.seq.set_position(t);
+  interrupts();
+}
+
+// Simulated crystal error (ppm) of a virtual node's ticks
+void set_skew(SyncNode &node, int32_t ppm) {
+  ppm = ppm < 1000 ? ppm : 1000;
+  ppm = ppm > -1000 ? ppm : -1000;
+  noInterrupts();
+  node.skew_ppm = ppm;
+  node.skew_step = (uint32_t)(ppm > 0 ? ppm : -ppm) * 4295;   // 2^32 / 10^6
+  node.skew_acc = 0;
+  interrupts();
+}
+
+// WiFi Connect Handler:
+// =====================
+/* This function is called by WifiManager when it successfully connects to a network.
+ * Virtual node i listens on the IoT port + i; a master's beacons go to all of them.
+ */
+void wifi_connected(void *userdata) {
+  for (int i = 0; i < SYNC_NUM_NODES; i++) {
+    nodes[i].port = wifi.get_iot_port() + i;
+    nodes[i].osc.open_port(nodes[i].port);
+    nodes[i].osc.set_sync_beacon(IPAddress(255, 255, 255, 255), wifi.get_iot_port(), SYNC_NUM_NODES);
+  }
+}
+
+// OSC Handlers:
+// ============
+/*
+ * /ping
+ *
+ * Responds with /pong <deviceID> <nodeID>.<index> <IPAddress> <port>. Replies go to
+ * the sender's IP on the IoT port.
+ */
+void osc_handle_ping(OSCMessage &msg) {
+  OSCMessage response("/pong");
+  char buff[32];
+  wifi.get_dev_id(buff);
+  response.add(buff);
+  response.add(current->node_id);
+  response.add(wifi.get_local_address().toString().c_str());
+  response.add((int32_t)current->port);
+  current->osc.set_dest(current->osc.remote_addr(), wifi.get_iot_port());
+  current->osc.send(response);
+}
+
+/*
+ * /config
+ *
+ * Open access point to configure network settings and device/node identifiers
+ */
+void osc_handle_config(OSCMessage &msg) {
+  wifi.open_access_point();
+}
+
+/*
+ * /rate <int/float>
+ *
+ * Set LFO rate in Hz
+ */
+void osc_handle_rate(OSCMessage &msg) {
+  UQ16x16 rate;
+  if (msg.isInt(0))
+    rate = msg.getInt(0);
+  else if (msg.isFloat(0))
+    rate = msg.getFloat(0);
+  else return;
+  current->lfo.set_rate(rate, timebase);
+  align(*current);
+}
+
+/*
+ * /dutycycle <float>
+ *
+ * Set LFO duty cycle [0-1]
+ */
+void osc_handle_dutycycle(OSCMessage &msg) {
+  if (msg.isFloat(0)) {
+    current->lfo.set_duty_cycle(msg.getFloat(0));
+    align(*current);
+  }
+}
+
+/*
+ * /sequence <int/float> <int/float> ... <int/float>
+ *
+ * Set up to 512 sequencer steps [0-255]
+ */
+void osc_handle_sequence(OSCMessage &msg) {
+  current->seq.clear();
+  for (int i = 0; i < msg.size(); i++) {
+    if (msg.isInt(i))
+      current->seq.append_step(msg.getInt(i));
+    else if (msg.isFloat(i))
+      current->seq.append_step((uint8_t)msg.getFloat(i));
+  }
+  align(*current);
+}
+
+/*
+ * /steptime <int/float>
+ *
+ * Sets the step duration in miliseconds
+ */
+void osc_handle_steptime(OSCMessage &msg) {
+  float time_ms;
+  if (msg.isInt(0))
+    time_ms = msg.getInt(0);
+  else if (msg.isFloat(0))
+    time_ms = msg.getFloat(0);
+  else return;
+  current->seq.set_step_length(timebase.ms_to_samples(time_ms));
+  align(*current);
+}
+
+/*
+ * /sync/master <int>
+ *
+ * Make this node the master (1), beaconing its clock to the others, or a node
+ * following the master (0)
+ */
+void osc_handle_sync_master(OSCMessage &msg) {
+  if (msg.isInt(0)) {
+    current->sync.set_master(msg.getInt(0));
+    current->sync.reset();
+  }
+}
+
+/*
+ * /sync/skew <int>
+ *
+ * Simulate a crystal error in ppm [-1000-1000] by skipping or doubling ticks
+ */
+void osc_handle_sync_skew(OSCMessage &msg) {
+  if (msg.isInt(0))
+    set_skew(*current, msg.getInt(0));
+}
+
+/*
+ * /sync/status
+ *
+ * Responds with /sync/status <nodeID>.<index> <master> <locked> <phase error> <round
+ * trip> <drift ppm> <time>: the phase error and round trip of the last exchange in
+ * samples, the estimated drift of this node's clock, and its synchronized time
+ */
+void osc_handle_sync_status(OSCMessage &msg) {
+  OSCMessage response("/sync/status");
+  response.add(current->node_id);
+  response.add((int32_t)current->sync.master());
+  response.add((int32_t)current->sync.locked());
+  response.add((int32_t)current->sync.phase_error());
+  response.add((int32_t)current->sync.round_trip());
+  response.add((int32_t)current->sync.drift_ppm());
+  response.add((int32_t)current->sync.now());
+  current->osc.set_dest(current->osc.remote_addr(), wifi.get_iot_port());
+  current->osc.send(response);
+}
@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+"""
+sync_monitor.py
+
+Makes one node of the sync example the master, optionally gives the others a
+simulated crystal error, and reports each node's lock, phase error, round trip
+and drift estimate once a second.
+
+    python3 sync_monitor.py 192.168.1.20 --nodes 4 --skew 80,-120,30
+
+Virtual node i of a device listens on PORT+i; the first node of the first device
+becomes the master. Replies are received on PORT, so run this on the machine
+configured as the OSC destination.
+"""
+import argparse
+import socket
+import struct
+import time
+
+
+def osc_pad(b):
+    return b + b'\0' * (4 - len(b) % 4)
+
+
+def osc_encode(path, *args):
+    tags = ','
+    data = b''
+    for a in args:
+        tags += 'i'
+        data += struct.pack('>i', a)
+    return osc_pad(path.encode()) + osc_pad(tags.encode()) + data
+
+
+def osc_decode(packet):
+    def string(i):
+        end = packet.index(b'\0', i)
+        return packet[i:end].decode(), (end + 4) & ~3
+    path, i = string(0)
+    tags, i = string(i)
+    args = []
+    for t in tags[1:]:
+        if t == 'i':
+            args.append(struct.unpack('>i', packet[i:i + 4])[0])
+            i += 4
+        elif t == 's':
+            s, i = string(i)
+            args.append(s)
+    return path, args
+
+
+def receive(sock, timeout):
+    """Collect replies until nothing arrives for `timeout` seconds"""
+    replies = []
+    sock.settimeout(timeout)
+    while True:
+        try:
+            packet, _ = sock.recvfrom(4096)
+        except socket.timeout:
+            return replies
+        replies.append(osc_decode(packet))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('devices', nargs='+', help='device IP addresses')
+    parser.add_argument('--port', type=int, default=8000, help='IoT port (default 8000)')
+    parser.add_argument('--nodes', type=int, default=4, help='virtual nodes per device')
+    parser.add_argument('--skew', default='',
+        help='comma-separated simulated crystal errors (ppm) for the non-master nodes')
+    args = parser.parse_args()
+
+    fleet = [(ip, args.port + i) for ip in args.devices for i in range(args.nodes)]
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(('', args.port))
+
+    # First node leads; the others follow with their simulated errors
+    skews = [int(s) for s in args.skew.split(',') if s]
+    for k, addr in enumerate(fleet):
+        sock.sendto(osc_encode('/sync/master', int(k == 0)), addr)
+        if k > 0:
+            sock.sendto(osc_encode('/sync/skew', skews[k - 1] if k - 1 < len(skews) else 0), addr)
+
+    while True:
+        time.sleep(1.0)
+        for addr in fleet:
+            sock.sendto(osc_encode('/sync/status'), addr)
+        status = {}
+        for path, reply in receive(sock, 0.2):
+            if path == '/sync/status':
+                status[reply[0]] = reply[1:]
+        print('\n%-12s %7s %7s %9s %9s %9s' % ('node', 'master', 'locked', 'error', 'rtt', 'drift'))
+        for node_id in sorted(status):
+            master, locked, error, rtt, drift, _ = status[node_id]
+            print('%-12s %7d %7d %9d %9d %9d' % (node_id, master, locked, error, rtt, drift))
+
+
+if __name__ == '__main__':
+    main()